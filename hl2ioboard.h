@@ -72,27 +72,206 @@
 #define BAND_5cm	196	// Frequency 5961.160 MHz
 #define BAND_3cm	204	// Frequency 9998.100 MHz
 
+#define TUNER_CACHE_SIZE	32
+
+#define TRACE_BITS		8
+#define TRACE_SIZE		(1 << TRACE_BITS)	// number of records in the trace
+#define ADC_STREAM_CHANNELS	5	// ADC 0 to 3 and the temperature sensor
+#define ADC_STREAM_HANDLERS	6	// maximum number of ADC stream handlers
+#define RESET_HANDLERS		8	// maximum number of register reset handlers
+
+#define FLASH_STORE_MAX_DATA	248	// maximum length of a flash store value
+#define FLASH_KEY_TUNER_CACHE	1	// flash store keys 0 to 127 are for the library, 128 to 254 for firmware
+#define FLASH_KEY_ADC_CAL	2
+#define FLASH_KEY_BAND_VOLTS_CAL	3
+
+#define BAND_VOLTS_FT817	1	// band voltage standards
+#define BAND_VOLTS_XIEGU	2
+#define BAND_VOLTS_ICOM		3
+
+#define BANK_WINDOW_SIZE	32	// register banks
+#define BANK_COUNT		8	// bank numbers 1 to BANK_COUNT - 1 are available
+#define BANK_TRACE		1	// the trace records
+#define BANK_CAPTURE		2	// the capture buffer
+#define BANK_FILTER_CAL		4	// the ADC filter calibration
+
+#define BANK_STATS		3	// the performance counter snapshot
+
+#define STATS_I2C_TRANSACTIONS	0	// performance counters in Stats[]
+#define STATS_I2C_WRITTEN	1	// bytes written by the host, including the register number
+#define STATS_I2C_READ		2	// bytes read by the host
+#define STATS_I2C_EMPTY		3	// transfers with no data, including address probes
+#define STATS_UNKNOWN_WRITES	4	// writes to registers that are not assigned
+#define STATS_BAND_CHANGES	5	// changes of the Tx frequency code
+#define STATS_EXTTR_EDGES	6	// T/R changes
+#define STATS_UART_RX		7	// serial frames received
+#define STATS_UART_TX		8	// serial frames sent
+#define STATS_LATENCY_LAST	9	// microseconds from the Tx frequency write to the outputs applied
+#define STATS_LATENCY_MAX	10
+#define STATS_COUNT		11
+
+#define TELEMETRY_SYNC		0x7E	// the first byte of a USB frame
+#define USB_FRAME_MAX_DATA	251	// maximum payload after the time in a USB frame
+
+#define TELEMETRY_REGISTERS	0x01	// REG_TELEMETRY bits
+#define TELEMETRY_ADC		0x02
+#define TELEMETRY_TRACE		0x04
+#define TELEMETRY_STATS		0x08
+
+#define TRACE_ENABLE		0x01	// REG_TRACE_CONTROL bits
+#define TRACE_WRITES		0x02	// also trace I2C register writes
+#define TRACE_CLEAR		0x80	// write to empty the trace
+
+#define TRACE_I2C_WRITE		1	// trace events: an I2C write of value to reg
+#define TRACE_RX_TX		2	// EXTTR changed, value is 1 for Rx and 0 for Tx
+#define TRACE_FAULT		3	// a protection trip, value is REG_FAULT
+#define TRACE_STATE		4	// a state machine changed to state value, reg is its control register
+#define TRACE_BAND		5	// the Tx band changed, value is the band code
+
 typedef void (*irq_handler)(uint8_t register_number, uint8_t register_datum);
+typedef void (*adc_handler)(uint8_t channel, uint16_t sample);
+typedef void (*reset_handler)(void);
+
+struct tuner_memory {		// the result of a tune for one frequency code and antenna
+	uint8_t fcode;
+	uint8_t antenna;
+	uint8_t result;		// final value of REG_ANTENNA_TUNER, zero for success
+	uint8_t swr_x10;	// SWR times ten, or zero if unknown
+	uint32_t time_ms;	// milliseconds since boot
+	uint32_t used;		// LRU clock, zero if the entry is empty
+};
+
+struct meter_point {		// a point in a power meter calibration table
+	uint16_t adc;		// ADC value
+	uint16_t power;		// power in units of 0.1 watts
+};
+
+struct band_volts_map {		// the band voltage for a band code
+	uint8_t band;
+	uint16_t millivolts;
+};
+
+struct swr_settle_config {	// SWR values are SWR times 100
+	uint16_t interval_ms;	// time between detector samples
+	uint16_t slope_max;	// maximum SWR change across the window
+	uint16_t variance_max;	// maximum variance of the SWR in the window
+	uint16_t swr_max;	// a stable SWR at or below this is a match
+	uint16_t stable_ms;	// a stable SWR above swr_max is accepted after this time
+	uint16_t min_ms;	// minimum tune time
+};
+
+struct amp_band_config {	// an amplifier with a serial port
+	uint8_t (*fcode2band)(uint8_t fcode);	// return the amp band for a frequency code
+	void (*change_band)(uint8_t band);	// send the band to the amp
+	bool (*band_ack)(uint8_t band);		// return true when the amp confirms the band, or NULL if change_band() waits
+	bool (*serial_idle)(void);		// return true if the serial port is free for a band change
+	uint8_t band_unknown;			// the band for an unknown frequency
+};
 
 void configure_pins(bool use_uart1, bool use_pwm4a);
 void configure_led_flasher(void);
 void fast_led_flasher(void);
 void i2c_slave_handler(i2c_inst_t *i2c, i2c_slave_event_t event);
+void register_write(uint8_t reg, uint8_t data);
+uint8_t register_read(uint8_t reg);
+bool register_add_reset_handler(reset_handler handler);
 void IrqRxTxChange(uint gpio, uint32_t events);
 void J4Pin8_millivolts(uint16_t millivolts);
 void ft817_band_volts(uint8_t band);
 void xiegu_band_volts(uint8_t band);
+void icom_band_volts(uint8_t band);
+uint16_t band_volts_millivolts(uint8_t standard, uint8_t band_code);
+void band_volts_band(uint8_t band_code, uint8_t default_standard);
+void band_volts_start(void);
+void band_volts_set(uint16_t millivolts);
+bool band_volts_running(void);
+void band_volts_poll(void);
 uint8_t tx_freq_to_band(uint64_t freq);
 void IcomAh4(uint8_t, uint8_t);
 uint8_t hertz2fcode(uint64_t hertz);
 uint64_t fcode2hertz(uint8_t fcode);
 uint8_t fcode2band(uint8_t fcode);
+void amp_band_start(const struct amp_band_config * config);
+void amp_band_tx(uint8_t band);
+void amp_band_poll(void);
+void tuner_cache_clear(void);
+struct tuner_memory * tuner_cache_lookup(uint8_t fcode, uint8_t antenna);
+bool tuner_cache_is_tuned(uint8_t fcode, uint8_t antenna);
+void tuner_cache_store(uint8_t fcode, uint8_t antenna, uint8_t result, uint8_t swr_x10);
+void tuner_cache_load(void);
+void tuner_cache_poll(void);
+uint8_t tuner_cache_tune_request(void);
+void tuner_cache_tune_swr(uint8_t swr_x10);
+void tuner_cache_bypass(void);
+void tuner_cache_tune_poll(uint8_t state);
+void flash_store_init(void);
+int flash_store_read(uint8_t key, void * data, uint8_t max_length);
+bool flash_store_write(uint8_t key, const void * data, uint8_t length);
+void flash_store_poll(void);
+uint16_t crc16_ccitt(uint16_t crc, const uint8_t * data, uint32_t length);
+void adc_stream_start(uint8_t channel_mask, uint32_t sample_rate);
+void adc_stream_stop(void);
+bool adc_stream_running(void);
+uint8_t adc_stream_channels(void);
+uint32_t adc_stream_rate(void);
+bool adc_stream_add_handler(adc_handler handler);
+uint32_t adc_stream_fast_start(uint8_t channel, uint32_t sample_rate, adc_handler handler);
+void adc_stream_fast_stop(void);
+uint32_t adc_stream_position(void);
+void swr_estimator_start(uint8_t reverse_channel, uint8_t forward_channel);
+uint16_t swr_x100(void);
+void swr_settle_start(const struct swr_settle_config * config);
+bool swr_settle_poll(void);
+uint32_t swr_settle_finish(void);
+void meter_start(uint8_t reverse_channel, uint8_t forward_channel);
+void meter_set_calibration(bool forward, const struct meter_point * table, uint8_t length);
+uint16_t meter_power(bool forward, uint16_t sample);
+uint16_t meter_swr_x100(uint16_t forward, uint16_t reverse);
+void meter_registers(void);
+void protect_start(uint8_t reverse_channel, uint8_t forward_channel, uint8_t outputs);
+void protect_drop_outputs(void);
+bool protect_tripped(void);
+void adc_filter_start(void);
+uint16_t adc_filter_value(uint8_t channel);
+void adc_filter_set_calibration(uint8_t channel, int16_t offset, uint16_t gain);
+void adc_filter_registers(uint8_t channel);
+void adc_filter_poll(void);
+void fan_control_start(void);
+void capture_init(void);
+void capture_trigger(void);
+void capture_poll(void);
+bool bank_register(uint8_t bank, void * data, uint16_t length, bool writable);
+uint8_t bank_read(uint8_t reg);
+void bank_write(uint8_t reg, uint8_t data);
+void stats_start(void);
+void stats_count(uint8_t counter);
+void stats_outputs_applied(void);
+void change_track_start(void);
+void change_track_poll(void);
+void change_track_registers(void);
+uint16_t change_track_take(void);
+void telemetry_start(void);
+void telemetry_poll(void);
+void telemetry_frame(uint8_t type, const uint8_t * data, uint8_t length);
+void usb_command_poll(void);
+void trace_start(void);
+void trace_event(uint8_t event, uint8_t reg, uint8_t value);
+void trace_registers(void);
+uint32_t trace_sequence(void);
+int trace_copy(uint32_t first, uint8_t * buffer, int count);
 
 extern uint8_t firmware_version_major;
 extern uint8_t firmware_version_minor;
 extern uint64_t new_tx_freq;
 extern uint8_t new_tx_fcode;
 extern bool rx_freq_changed;
+extern volatile uint32_t i2c_activity_us;
+extern volatile uint16_t adc_stream_latest[ADC_STREAM_CHANNELS];
+extern volatile uint32_t adc_stream_count;
+extern volatile uint32_t adc_stream_irq_us;
+extern uint32_t protect_trips;
+extern volatile uint32_t Stats[STATS_COUNT];
+extern volatile uint32_t stats_tx_freq_us;
 extern uint8_t rx_freq_high;
 extern uint8_t rx_freq_low;
 extern uint8_t Registers[256];
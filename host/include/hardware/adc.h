@@ -0,0 +1,39 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// Host version of the Pico SDK header for the emulator build. The ADC inputs are set by host_adc_set(), and
+// the FIFO is filled by the emulator tick. See host/pico_host.c.
+
+#ifndef HOST_HARDWARE_ADC_H
+#define HOST_HARDWARE_ADC_H
+
+#include "pico/stdlib.h"
+
+#define ADC_FCS_OVER_BITS	0x00000800u
+#define ADC_FCS_UNDER_BITS	0x00000400u
+#define DREQ_ADC		36
+
+typedef struct {
+	volatile uint32_t cs, result, fcs, fifo, div, intr, inte, intf, ints;
+} adc_hw_t;
+
+extern adc_hw_t * adc_hw;
+
+void adc_init(void);
+void adc_gpio_init(uint gpio);
+void adc_select_input(uint input);
+uint adc_get_selected_input(void);
+uint16_t adc_read(void);
+void adc_set_round_robin(uint input_mask);
+void adc_set_temp_sensor_enabled(bool enable);
+void adc_set_clkdiv(float clkdiv);
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift);
+void adc_irq_set_enabled(bool enabled);
+void adc_run(bool run);
+bool adc_fifo_is_empty(void);
+uint8_t adc_fifo_get_level(void);
+uint16_t adc_fifo_get(void);
+void adc_fifo_drain(void);
+
+#endif
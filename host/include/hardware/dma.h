@@ -0,0 +1,65 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// Host version of the Pico SDK header for the emulator build. The emulator keeps the channel registers, and
+// moves data only for channels paced by DREQ_ADC. See host/pico_host.c.
+
+#ifndef HOST_HARDWARE_DMA_H
+#define HOST_HARDWARE_DMA_H
+
+#include "pico/stdlib.h"
+
+#define DREQ_PWM_WRAP0	24
+#define DREQ_ADC	36
+#define DREQ_FORCE	63
+
+enum dma_channel_transfer_size {
+	DMA_SIZE_8,
+	DMA_SIZE_16,
+	DMA_SIZE_32,
+};
+
+typedef struct {
+	uint32_t ctrl;
+} dma_channel_config;
+
+typedef struct {
+	volatile uint32_t read_addr, write_addr, transfer_count, al1_ctrl;
+} dma_channel_hw_t;
+
+typedef struct {
+	volatile uint32_t read_addr, write_addr, transfer_count, ctrl_trig;
+	volatile uint32_t al1_ctrl, al1_read_addr, al1_write_addr, al1_transfer_count_trig;
+	volatile uint32_t al2_ctrl, al2_transfer_count, al2_read_addr, al2_write_addr_trig;
+	volatile uint32_t al3_ctrl, al3_write_addr, al3_transfer_count, al3_read_addr_trig;
+} dma_channel_full_hw_t;
+
+typedef struct {
+	dma_channel_full_hw_t ch[12];
+	volatile uint32_t intr, inte0, intf0, ints0;
+} dma_hw_t;
+
+extern dma_hw_t * dma_hw;
+
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config * c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config * c, bool incr);
+void channel_config_set_write_increment(dma_channel_config * c, bool incr);
+void channel_config_set_dreq(dma_channel_config * c, uint dreq);
+void channel_config_set_ring(dma_channel_config * c, bool write, uint size_bits);
+void channel_config_set_chain_to(dma_channel_config * c, uint chain_to);
+void dma_channel_configure(uint channel, const dma_channel_config * config, volatile void * write_addr,
+	const volatile void * read_addr, uint transfer_count, bool trigger);
+dma_channel_hw_t * dma_channel_hw_addr(uint channel);
+void dma_channel_set_write_addr(uint channel, volatile void * write_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+void dma_channel_start(uint channel);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+bool dma_channel_get_irq0_status(uint channel);
+void dma_channel_acknowledge_irq0(uint channel);
+
+#endif
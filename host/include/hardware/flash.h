@@ -0,0 +1,18 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// Host version of the Pico SDK header for the emulator build. The flash is the array host_flash.
+
+#ifndef HOST_HARDWARE_FLASH_H
+#define HOST_HARDWARE_FLASH_H
+
+#include "pico/stdlib.h"
+
+#define FLASH_PAGE_SIZE		(1u << 8)
+#define FLASH_SECTOR_SIZE	(1u << 12)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t * data, size_t count);
+
+#endif
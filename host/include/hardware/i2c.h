@@ -0,0 +1,20 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// Host version of the Pico SDK header for the emulator build.
+
+#ifndef HOST_HARDWARE_I2C_H
+#define HOST_HARDWARE_I2C_H
+
+#include "pico/stdlib.h"
+
+typedef struct i2c_inst i2c_inst_t;
+extern i2c_inst_t * i2c0;
+extern i2c_inst_t * i2c1;
+
+uint i2c_init(i2c_inst_t * i2c, uint baudrate);
+uint8_t i2c_read_byte_raw(i2c_inst_t * i2c);
+void i2c_write_byte_raw(i2c_inst_t * i2c, uint8_t value);
+
+#endif
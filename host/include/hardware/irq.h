@@ -0,0 +1,22 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// Host version of the Pico SDK header for the emulator build.
+
+#ifndef HOST_HARDWARE_IRQ_H
+#define HOST_HARDWARE_IRQ_H
+
+#include <stdbool.h>
+
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY	0x80
+#define PICO_HIGHEST_IRQ_PRIORITY	0
+
+typedef void (*irq_handler_t)(void);
+
+void irq_set_exclusive_handler(unsigned num, irq_handler_t handler);
+void irq_add_shared_handler(unsigned num, irq_handler_t handler, unsigned char order_priority);
+void irq_set_enabled(unsigned num, bool enabled);
+void irq_set_priority(unsigned num, unsigned char priority);
+
+#endif
@@ -0,0 +1,53 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// Host version of the Pico SDK header for the emulator build. The PWM registers are plain memory in pwm_hw.
+
+#ifndef HOST_HARDWARE_PWM_H
+#define HOST_HARDWARE_PWM_H
+
+#include "pico/stdlib.h"
+
+#define PWM_CHAN_A	0
+#define PWM_CHAN_B	1
+
+enum pwm_clkdiv_mode {
+	PWM_DIV_FREE_RUNNING,
+	PWM_DIV_B_HIGH,
+	PWM_DIV_B_RISING,
+	PWM_DIV_B_FALLING,
+};
+
+typedef struct {
+	uint32_t csr;
+	uint32_t div;
+	uint32_t top;
+} pwm_config;
+
+typedef struct {
+	volatile uint32_t csr, div, ctr, cc, top;
+} pwm_slice_hw_t;
+
+typedef struct {
+	pwm_slice_hw_t slice[8];
+	volatile uint32_t en, intr, inte, intf, ints;
+} pwm_hw_t;
+
+extern pwm_hw_t * pwm_hw;
+
+uint pwm_gpio_to_slice_num(uint gpio);
+uint pwm_gpio_to_channel(uint gpio);
+pwm_config pwm_get_default_config(void);
+void pwm_config_set_clkdiv_mode(pwm_config * c, enum pwm_clkdiv_mode mode);
+void pwm_config_set_clkdiv(pwm_config * c, float div);
+void pwm_init(uint slice, pwm_config * c, bool start);
+void pwm_set_wrap(uint slice, uint16_t wrap);
+void pwm_set_chan_level(uint slice, uint chan, uint16_t level);
+void pwm_set_gpio_level(uint gpio, uint16_t level);
+void pwm_set_enabled(uint slice, bool enabled);
+void pwm_set_clkdiv(uint slice, float div);
+uint16_t pwm_get_counter(uint slice);
+void pwm_set_counter(uint slice, uint16_t value);
+
+#endif
@@ -0,0 +1,34 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// Host version of the Pico SDK header for the emulator build. The UART data goes to ring buffers that
+// are read and written by host_uart_read() and host_uart_write().
+
+#ifndef HOST_HARDWARE_UART_H
+#define HOST_HARDWARE_UART_H
+
+#include "pico/stdlib.h"
+
+typedef struct uart_inst uart_inst_t;
+extern uart_inst_t * uart0;
+extern uart_inst_t * uart1;
+
+typedef enum {
+	UART_PARITY_NONE,
+	UART_PARITY_EVEN,
+	UART_PARITY_ODD,
+} uart_parity_t;
+
+uint uart_init(uart_inst_t * uart, uint baudrate);
+void uart_set_hw_flow(uart_inst_t * uart, bool cts, bool rts);
+void uart_set_format(uart_inst_t * uart, uint data_bits, uint stop_bits, uart_parity_t parity);
+void uart_set_fifo_enabled(uart_inst_t * uart, bool enabled);
+void uart_set_irq_enables(uart_inst_t * uart, bool rx_has_data, bool tx_needs_data);
+bool uart_is_readable(uart_inst_t * uart);
+char uart_getc(uart_inst_t * uart);
+void uart_putc_raw(uart_inst_t * uart, char c);
+void uart_puts(uart_inst_t * uart, const char * s);
+void uart_write_blocking(uart_inst_t * uart, const uint8_t * src, size_t len);
+
+#endif
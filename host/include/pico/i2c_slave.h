@@ -0,0 +1,23 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// Host version of the Pico SDK header for the emulator build. The emulator calls the handler with the
+// events of each transfer from host_i2c_write() and host_i2c_read().
+
+#ifndef HOST_PICO_I2C_SLAVE_H
+#define HOST_PICO_I2C_SLAVE_H
+
+#include "hardware/i2c.h"
+
+typedef enum {
+	I2C_SLAVE_RECEIVE,
+	I2C_SLAVE_REQUEST,
+	I2C_SLAVE_FINISH,
+} i2c_slave_event_t;
+
+typedef void (*i2c_slave_handler_t)(i2c_inst_t * i2c, i2c_slave_event_t event);
+
+void i2c_slave_init(i2c_inst_t * i2c, uint8_t address, i2c_slave_handler_t handler);
+
+#endif
@@ -0,0 +1,74 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// Host version of the Pico SDK header for the emulator build. See host/pico_host.c.
+
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;	// microseconds since boot
+
+#define PICO_ERROR_TIMEOUT	(-1)
+#define PICO_FLASH_SIZE_BYTES	(2 * 1024 * 1024)
+
+extern uint8_t host_flash[];		// the flash memory, read at XIP_BASE
+#define XIP_BASE		((uintptr_t)host_flash)
+
+#define UART0_IRQ		20
+#define UART1_IRQ		21
+#define ADC_IRQ_FIFO		22
+#define DMA_IRQ_0		11
+#define DMA_IRQ_1		12
+#define PWM_IRQ_WRAP		4
+
+#define __not_in_flash_func(f)		f
+#define __time_critical_func(f)		f
+#define __no_inline_not_in_flash_func(f)	f
+#define count_of(a)		(sizeof(a) / sizeof((a)[0]))
+#define __dmb()			__sync_synchronize()
+#define __compiler_memory_barrier()	__asm__ volatile ("" ::: "memory")
+
+absolute_time_t get_absolute_time(void);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+bool time_reached(absolute_time_t t);
+uint32_t to_ms_since_boot(absolute_time_t t);
+uint64_t to_us_since_boot(absolute_time_t t);
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+void busy_wait_us(uint64_t us);
+
+bool stdio_init_all(void);
+int getchar_timeout_us(uint32_t timeout_us);
+int putchar_raw(int c);
+void stdio_flush(void);
+
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t * rt);
+struct repeating_timer {
+	int64_t delay_us;
+	void * user_data;
+	repeating_timer_callback_t callback;
+	uint64_t next_us;
+	repeating_timer_t * next;
+};
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void * user_data, repeating_timer_t * out);
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void * user_data, repeating_timer_t * out);
+bool cancel_repeating_timer(repeating_timer_t * timer);
+
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+#include "hardware/irq.h"
+
+#endif
@@ -0,0 +1,1107 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This is the part of the Pico SDK that the IO board firmware uses, written for a Linux or macOS host. It is
+// linked with n2adr_lib and one firmware main.c into a shared library, and software/hl2_emulator.py loads the
+// library and calls the host_*() functions below to start the firmware, make I2C transfers, set the input pins
+// and ADC inputs, and read and write the USB serial port and the UART.
+//
+// The firmware main() runs in its own thread. Interrupts are emulated by a recursive mutex: an interrupt handler
+// runs with the mutex held, and save_and_disable_interrupts() takes the mutex. So the I2C handler, the GPIO
+// callback, the repeating timers and the ADC and UART interrupts never run at the same time as each other or a
+// section with interrupts disabled, as on the Pico. Unlike the Pico, main() is not stopped while a handler runs.
+// A tick thread runs the repeating timers and fills the ADC FIFO at the ADC rate, one millisecond at a time.
+// The DMA channel registers are kept. A channel paced by DREQ_ADC moves the samples from the ADC FIFO, with
+// the write ring, chaining and DMA_IRQ_0 of the Pico. For other channels no data is moved: a transfer with a
+// count of 0xFFFFFFFF is busy until it is aborted, and any other transfer is done at once. The flash is the
+// array host_flash.
+// Output from printf() goes to the standard output of the host, not to the USB serial port.
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <hardware/gpio.h>
+#include <hardware/i2c.h>
+#include <pico/i2c_slave.h>
+#include <hardware/pwm.h>
+#include <hardware/adc.h>
+#include <hardware/dma.h>
+#include <hardware/flash.h>
+#include <hardware/uart.h>
+
+#define HOST_GPIO_COUNT		30
+#define HOST_IRQ_COUNT		32
+#define HOST_TICK_US		1000	// period of the tick thread
+#define HOST_ADC_FIFO		4	// depth of the ADC FIFO
+#define HOST_ADC_MAX_TICK	1000	// most ADC samples in one tick; more are skipped
+#define HOST_RING_SIZE		4096	// USB and UART buffers, must be a power of two
+#define HOST_DMA_CHANNELS	12
+#define HOST_DMA_ENDLESS	0xFFFFFFFF
+#define HOST_DMA_EN		0x00000001u	// the bits of the DMA channel control register
+#define HOST_DMA_SIZE_SHIFT	2
+#define HOST_DMA_INCR_READ	0x00000010u
+#define HOST_DMA_INCR_WRITE	0x00000020u
+#define HOST_DMA_RING_SHIFT	6
+#define HOST_DMA_RING_WRITE	0x00000400u
+#define HOST_DMA_CHAIN_SHIFT	11
+#define HOST_DMA_TREQ_SHIFT	15
+
+struct host_ring {
+	uint8_t data[HOST_RING_SIZE];
+	uint32_t head, tail;	// write at head, read at tail
+};
+
+struct i2c_inst {
+	uint8_t data;		// the byte received or to send
+};
+
+struct uart_inst {
+	uint8_t index;
+	bool rx_irq;
+	struct host_ring rx, tx;
+};
+
+extern int firmware_main(void);		// the firmware main(), renamed by host/CMakeLists.txt
+
+uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+
+static pthread_mutex_t irq_lock;	// held by interrupt handlers and while interrupts are disabled
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec boot_time;
+static bool host_running = false;
+
+static struct i2c_inst host_i2c[2];
+i2c_inst_t * i2c0 = host_i2c;
+i2c_inst_t * i2c1 = host_i2c + 1;
+static i2c_slave_handler_t i2c_handler;
+static i2c_inst_t * i2c_slave;
+static uint8_t i2c_address;
+
+static struct uart_inst host_uart[2] = {{0}, {1}};
+uart_inst_t * uart0 = host_uart;
+uart_inst_t * uart1 = host_uart + 1;
+
+static struct host_ring usb_in, usb_out;	// USB serial port from and to the host
+
+static uint8_t gpio_function[HOST_GPIO_COUNT];
+static uint32_t gpio_dir, gpio_out, gpio_in;
+static uint32_t gpio_irq_events[HOST_GPIO_COUNT];
+static gpio_irq_callback_t gpio_callback;
+
+static irq_handler_t irq_handlers[HOST_IRQ_COUNT];
+static bool irq_enabled[HOST_IRQ_COUNT];
+
+static repeating_timer_t * timer_list;
+
+static pwm_hw_t host_pwm_hw;
+pwm_hw_t * pwm_hw = &host_pwm_hw;
+
+static adc_hw_t host_adc_hw;
+adc_hw_t * adc_hw = &host_adc_hw;
+static uint16_t adc_input[5] = {0, 0, 0, 0, 964};	// channel 4 is the temperature sensor at 27 C
+static uint16_t adc_fifo[HOST_ADC_FIFO];
+static uint8_t adc_fifo_level;
+static uint8_t adc_selected, adc_round_robin, adc_dreq_thresh;
+static bool adc_fifo_enabled, adc_dreq, adc_irq, adc_running;
+static float adc_clkdiv;
+static double adc_samples_due;
+
+static dma_hw_t host_dma_hw;
+dma_hw_t * dma_hw = &host_dma_hw;
+static uint16_t dma_claimed;
+static bool dma_busy[HOST_DMA_CHANNELS];
+static uint8_t * dma_write[HOST_DMA_CHANNELS];		// the write address as a host pointer
+static uint32_t dma_reload[HOST_DMA_CHANNELS];		// the transfer count for the next trigger
+
+__attribute__((constructor)) static void host_init(void)
+{
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&irq_lock, &attr);
+	clock_gettime(CLOCK_MONOTONIC, &boot_time);
+	memset(host_flash, 0xFF, sizeof(host_flash));
+}
+
+// Time
+
+uint64_t time_us_64(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)(now.tv_sec - boot_time.tv_sec) * 1000000 + (now.tv_nsec - boot_time.tv_nsec) / 1000;
+}
+
+uint32_t time_us_32(void)
+{
+	return (uint32_t)time_us_64();
+}
+
+absolute_time_t get_absolute_time(void)
+{
+	return time_us_64();
+}
+
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to)
+{
+	return (int64_t)(to - from);
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+	return time_us_64() + (uint64_t)ms * 1000;
+}
+
+bool time_reached(absolute_time_t t)
+{
+	return time_us_64() >= t;
+}
+
+uint32_t to_ms_since_boot(absolute_time_t t)
+{
+	return (uint32_t)(t / 1000);
+}
+
+uint64_t to_us_since_boot(absolute_time_t t)
+{
+	return t;
+}
+
+void sleep_us(uint64_t us)
+{
+	struct timespec delay;
+
+	delay.tv_sec = us / 1000000;
+	delay.tv_nsec = (us % 1000000) * 1000;
+	nanosleep(&delay, NULL);
+}
+
+void sleep_ms(uint32_t ms)
+{
+	sleep_us((uint64_t)ms * 1000);
+}
+
+void busy_wait_us(uint64_t us)
+{
+	uint64_t end = time_us_64() + us;
+
+	while (time_us_64() < end)
+		;
+}
+
+// Interrupts
+
+uint32_t save_and_disable_interrupts(void)
+{
+	pthread_mutex_lock(&irq_lock);
+	return 0;
+}
+
+void restore_interrupts(uint32_t status)
+{
+	pthread_mutex_unlock(&irq_lock);
+}
+
+void irq_set_exclusive_handler(unsigned num, irq_handler_t handler)
+{
+	if (num < HOST_IRQ_COUNT)
+		irq_handlers[num] = handler;
+}
+
+void irq_add_shared_handler(unsigned num, irq_handler_t handler, unsigned char order_priority)
+{
+	irq_set_exclusive_handler(num, handler);
+}
+
+void irq_set_enabled(unsigned num, bool enabled)
+{
+	if (num < HOST_IRQ_COUNT)
+		irq_enabled[num] = enabled;
+}
+
+void irq_set_priority(unsigned num, unsigned char priority)
+{
+}
+
+// Call the handler for an interrupt if it is enabled. The caller holds irq_lock.
+static void host_irq(unsigned num)
+{
+	if (irq_enabled[num] && irq_handlers[num])
+		(irq_handlers[num])();
+}
+
+// Repeating timers are called from the tick thread.
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void * user_data, repeating_timer_t * out)
+{
+	out->delay_us = delay_us;
+	out->user_data = user_data;
+	out->callback = callback;
+	out->next_us = time_us_64() + (delay_us < 0 ? -delay_us : delay_us);
+	pthread_mutex_lock(&irq_lock);
+	out->next = timer_list;
+	timer_list = out;
+	pthread_mutex_unlock(&irq_lock);
+	return true;
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void * user_data, repeating_timer_t * out)
+{
+	return add_repeating_timer_us((int64_t)delay_ms * 1000, callback, user_data, out);
+}
+
+bool cancel_repeating_timer(repeating_timer_t * timer)
+{
+	repeating_timer_t ** p;
+	bool found = false;
+
+	pthread_mutex_lock(&irq_lock);
+	for (p = &timer_list; *p; p = &(*p)->next) {
+		if (*p == timer) {
+			*p = timer->next;
+			found = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&irq_lock);
+	return found;
+}
+
+// GPIO
+
+void gpio_init(uint gpio)
+{
+	gpio_set_dir(gpio, GPIO_IN);
+	gpio_put(gpio, 0);
+	gpio_set_function(gpio, GPIO_FUNC_SIO);
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+	if (gpio < HOST_GPIO_COUNT)
+		gpio_function[gpio] = fn;
+}
+
+enum gpio_function gpio_get_function(uint gpio)
+{
+	return gpio < HOST_GPIO_COUNT ? gpio_function[gpio] : GPIO_FUNC_NULL;
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+	if (out)
+		gpio_dir |= 1u << gpio;
+	else
+		gpio_dir &= ~(1u << gpio);
+}
+
+void gpio_put(uint gpio, bool value)
+{
+	if (value)
+		__atomic_or_fetch(&gpio_out, 1u << gpio, __ATOMIC_SEQ_CST);
+	else
+		__atomic_and_fetch(&gpio_out, ~(1u << gpio), __ATOMIC_SEQ_CST);
+}
+
+void gpio_set_mask(uint32_t mask)
+{
+	__atomic_or_fetch(&gpio_out, mask, __ATOMIC_SEQ_CST);
+}
+
+void gpio_clr_mask(uint32_t mask)
+{
+	__atomic_and_fetch(&gpio_out, ~mask, __ATOMIC_SEQ_CST);
+}
+
+void gpio_xor_mask(uint32_t mask)
+{
+	__atomic_xor_fetch(&gpio_out, mask, __ATOMIC_SEQ_CST);
+}
+
+// The pin level is the output for an output pin and the level set by host_gpio_set_input() for an input.
+uint32_t gpio_get_all(void)
+{
+	return (gpio_out & gpio_dir) | (gpio_in & ~gpio_dir);
+}
+
+bool gpio_get(uint gpio)
+{
+	return (gpio_get_all() >> gpio) & 1;
+}
+
+void gpio_disable_pulls(uint gpio)
+{
+}
+
+void gpio_pull_up(uint gpio)
+{
+}
+
+void gpio_pull_down(uint gpio)
+{
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled)
+{
+	if (gpio >= HOST_GPIO_COUNT)
+		return;
+	if (enabled)
+		gpio_irq_events[gpio] |= events;
+	else
+		gpio_irq_events[gpio] &= ~events;
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback)
+{
+	gpio_set_irq_enabled(gpio, events, enabled);
+	if (enabled)
+		gpio_callback = callback;
+}
+
+// I2C slave
+
+uint i2c_init(i2c_inst_t * i2c, uint baudrate)
+{
+	return baudrate;
+}
+
+uint8_t i2c_read_byte_raw(i2c_inst_t * i2c)
+{
+	return i2c->data;
+}
+
+void i2c_write_byte_raw(i2c_inst_t * i2c, uint8_t value)
+{
+	i2c->data = value;
+}
+
+void i2c_slave_init(i2c_inst_t * i2c, uint8_t address, i2c_slave_handler_t handler)
+{
+	pthread_mutex_lock(&irq_lock);
+	i2c_slave = i2c;
+	i2c_address = address;
+	i2c_handler = handler;
+	pthread_mutex_unlock(&irq_lock);
+}
+
+// PWM
+
+uint pwm_gpio_to_slice_num(uint gpio)
+{
+	return (gpio >> 1) & 7;
+}
+
+uint pwm_gpio_to_channel(uint gpio)
+{
+	return gpio & 1;
+}
+
+pwm_config pwm_get_default_config(void)
+{
+	pwm_config c = {0, 1 << 4, 0xFFFF};
+
+	return c;
+}
+
+void pwm_config_set_clkdiv_mode(pwm_config * c, enum pwm_clkdiv_mode mode)
+{
+	c->csr = (c->csr & ~0x30) | (mode << 4);
+}
+
+void pwm_config_set_clkdiv(pwm_config * c, float div)
+{
+	c->div = (uint32_t)(div * 16);
+}
+
+void pwm_init(uint slice, pwm_config * c, bool start)
+{
+	pwm_hw->slice[slice].csr = c->csr | (start ? 1 : 0);
+	pwm_hw->slice[slice].div = c->div;
+	pwm_hw->slice[slice].top = c->top;
+	pwm_hw->slice[slice].ctr = 0;
+	pwm_hw->slice[slice].cc = 0;
+}
+
+void pwm_set_wrap(uint slice, uint16_t wrap)
+{
+	pwm_hw->slice[slice].top = wrap;
+}
+
+void pwm_set_chan_level(uint slice, uint chan, uint16_t level)
+{
+	if (chan == PWM_CHAN_A)
+		pwm_hw->slice[slice].cc = (pwm_hw->slice[slice].cc & 0xFFFF0000) | level;
+	else
+		pwm_hw->slice[slice].cc = (pwm_hw->slice[slice].cc & 0xFFFF) | (uint32_t)level << 16;
+}
+
+void pwm_set_gpio_level(uint gpio, uint16_t level)
+{
+	pwm_set_chan_level(pwm_gpio_to_slice_num(gpio), pwm_gpio_to_channel(gpio), level);
+}
+
+void pwm_set_enabled(uint slice, bool enabled)
+{
+	if (enabled)
+		pwm_hw->slice[slice].csr |= 1;
+	else
+		pwm_hw->slice[slice].csr &= ~1u;
+}
+
+void pwm_set_clkdiv(uint slice, float div)
+{
+	pwm_hw->slice[slice].div = (uint32_t)(div * 16);
+}
+
+uint16_t pwm_get_counter(uint slice)
+{
+	return pwm_hw->slice[slice].ctr;
+}
+
+void pwm_set_counter(uint slice, uint16_t value)
+{
+	pwm_hw->slice[slice].ctr = value;
+}
+
+// ADC
+
+void adc_init(void)
+{
+	adc_run(false);
+	adc_fifo_setup(false, false, 0, false, false);
+	adc_fifo_drain();
+	adc_selected = 0;
+	adc_round_robin = 0;
+}
+
+void adc_gpio_init(uint gpio)
+{
+	gpio_set_function(gpio, GPIO_FUNC_NULL);
+}
+
+void adc_select_input(uint input)
+{
+	adc_selected = input < 5 ? input : 0;
+}
+
+uint adc_get_selected_input(void)
+{
+	return adc_selected;
+}
+
+uint16_t adc_read(void)
+{
+	return adc_input[adc_selected];
+}
+
+void adc_set_round_robin(uint input_mask)
+{
+	adc_round_robin = input_mask & 0x1F;
+}
+
+void adc_set_temp_sensor_enabled(bool enable)
+{
+}
+
+void adc_set_clkdiv(float clkdiv)
+{
+	adc_clkdiv = clkdiv;
+}
+
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift)
+{
+	adc_fifo_enabled = en;
+	adc_dreq = dreq_en;
+	adc_dreq_thresh = dreq_thresh ? dreq_thresh : 1;
+}
+
+void adc_irq_set_enabled(bool enabled)
+{
+	adc_irq = enabled;
+}
+
+// The firmware clears ADC_FCS_OVER_BITS by writing a one, which the host memory can not do. So clear it here.
+void adc_run(bool run)
+{
+	adc_running = run;
+	adc_samples_due = 0;
+	if (run)
+		adc_hw->fcs &= ~ADC_FCS_OVER_BITS;
+}
+
+bool adc_fifo_is_empty(void)
+{
+	return adc_fifo_level == 0;
+}
+
+uint8_t adc_fifo_get_level(void)
+{
+	return adc_fifo_level;
+}
+
+uint16_t adc_fifo_get(void)
+{
+	uint16_t sample;
+
+	if (adc_fifo_level == 0) {
+		adc_hw->fcs |= ADC_FCS_UNDER_BITS;
+		return 0;
+	}
+	sample = adc_fifo[0];
+	adc_fifo_level--;
+	memmove(adc_fifo, adc_fifo + 1, adc_fifo_level * sizeof(adc_fifo[0]));
+	return sample;
+}
+
+void adc_fifo_drain(void)
+{
+	adc_fifo_level = 0;
+}
+
+// Convert the next channel into the FIFO and call the ADC interrupt. The caller holds irq_lock.
+static void host_dma_adc(void);
+
+static void host_adc_sample(void)
+{
+	uint8_t mask, next;
+
+	if (adc_fifo_level < HOST_ADC_FIFO)
+		adc_fifo[adc_fifo_level++] = adc_input[adc_selected];
+	else
+		adc_hw->fcs |= ADC_FCS_OVER_BITS;
+	mask = adc_round_robin;
+	if (mask) {		// the next channel in the round robin
+		next = adc_selected;
+		do {
+			next = (next + 1) % 5;
+		} while ( ! (mask & (1 << next)));
+		adc_selected = next;
+	}
+	if (adc_dreq)
+		host_dma_adc();
+	if (adc_irq && adc_fifo_level >= adc_dreq_thresh)
+		host_irq(ADC_IRQ_FIFO);
+}
+
+// Run the ADC for the elapsed time. The caller holds irq_lock.
+static void host_adc_tick(uint32_t elapsed_us)
+{
+	int i, count;
+
+	if ( ! adc_running || ! adc_fifo_enabled)
+		return;
+	adc_samples_due += elapsed_us * 48.0 / (adc_clkdiv + 1.0);
+	count = (int)adc_samples_due;
+	adc_samples_due -= count;
+	if (count > HOST_ADC_MAX_TICK)
+		count = HOST_ADC_MAX_TICK;
+	for (i = 0; i < count && adc_running; i++)
+		host_adc_sample();
+}
+
+// DMA
+
+int dma_claim_unused_channel(bool required)
+{
+	int channel;
+
+	for (channel = 0; channel < HOST_DMA_CHANNELS; channel++) {
+		if ( ! (dma_claimed & (1 << channel))) {
+			dma_claimed |= 1 << channel;
+			return channel;
+		}
+	}
+	return -1;
+}
+
+// The defaults are those of the Pico SDK: 32 bits, increment the read address, no DREQ and chain to itself.
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+	dma_channel_config c = {HOST_DMA_EN | DMA_SIZE_32 << HOST_DMA_SIZE_SHIFT | HOST_DMA_INCR_READ |
+		channel << HOST_DMA_CHAIN_SHIFT | DREQ_FORCE << HOST_DMA_TREQ_SHIFT};
+
+	return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config * c, enum dma_channel_transfer_size size)
+{
+	c->ctrl = (c->ctrl & ~(3u << HOST_DMA_SIZE_SHIFT)) | size << HOST_DMA_SIZE_SHIFT;
+}
+
+void channel_config_set_read_increment(dma_channel_config * c, bool incr)
+{
+	c->ctrl = incr ? c->ctrl | HOST_DMA_INCR_READ : c->ctrl & ~HOST_DMA_INCR_READ;
+}
+
+void channel_config_set_write_increment(dma_channel_config * c, bool incr)
+{
+	c->ctrl = incr ? c->ctrl | HOST_DMA_INCR_WRITE : c->ctrl & ~HOST_DMA_INCR_WRITE;
+}
+
+void channel_config_set_dreq(dma_channel_config * c, uint dreq)
+{
+	c->ctrl = (c->ctrl & ~(0x3Fu << HOST_DMA_TREQ_SHIFT)) | dreq << HOST_DMA_TREQ_SHIFT;
+}
+
+void channel_config_set_ring(dma_channel_config * c, bool write, uint size_bits)
+{
+	c->ctrl = (c->ctrl & ~(0x1Fu << HOST_DMA_RING_SHIFT)) | size_bits << HOST_DMA_RING_SHIFT |
+		(write ? HOST_DMA_RING_WRITE : 0);
+}
+
+void channel_config_set_chain_to(dma_channel_config * c, uint chain_to)
+{
+	c->ctrl = (c->ctrl & ~(0xFu << HOST_DMA_CHAIN_SHIFT)) | chain_to << HOST_DMA_CHAIN_SHIFT;
+}
+
+static bool host_dma_adc_paced(uint channel)
+{
+	return (dma_hw->ch[channel].ctrl_trig >> HOST_DMA_TREQ_SHIFT & 0x3F) == DREQ_ADC;
+}
+
+void dma_channel_start(uint channel)
+{
+	dma_hw->ch[channel].transfer_count = dma_reload[channel];
+	if (host_dma_adc_paced(channel))
+		dma_busy[channel] = dma_reload[channel] != 0;
+	else
+		dma_busy[channel] = dma_reload[channel] == HOST_DMA_ENDLESS;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config * config, volatile void * write_addr,
+	const volatile void * read_addr, uint transfer_count, bool trigger)
+{
+	dma_hw->ch[channel].ctrl_trig = config->ctrl;
+	dma_hw->ch[channel].write_addr = (uint32_t)(uintptr_t)write_addr;
+	dma_write[channel] = (uint8_t *)write_addr;
+	dma_hw->ch[channel].read_addr = (uint32_t)(uintptr_t)read_addr;
+	dma_hw->ch[channel].transfer_count = transfer_count;
+	dma_reload[channel] = transfer_count;
+	if (trigger)
+		dma_channel_start(channel);
+}
+
+dma_channel_hw_t * dma_channel_hw_addr(uint channel)
+{
+	return (dma_channel_hw_t *)&dma_hw->ch[channel];
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void * write_addr, bool trigger)
+{
+	dma_hw->ch[channel].write_addr = (uint32_t)(uintptr_t)write_addr;
+	dma_write[channel] = (uint8_t *)write_addr;
+	if (trigger)
+		dma_channel_start(channel);
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger)
+{
+	dma_reload[channel] = trans_count;
+	if (trigger)
+		dma_channel_start(channel);
+}
+
+void dma_channel_abort(uint channel)
+{
+	dma_busy[channel] = false;
+}
+
+bool dma_channel_is_busy(uint channel)
+{
+	return dma_busy[channel];
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled)
+{
+	if (enabled)
+		dma_hw->inte0 |= 1u << channel;
+	else
+		dma_hw->inte0 &= ~(1u << channel);
+}
+
+bool dma_channel_get_irq0_status(uint channel)
+{
+	return dma_hw->ints0 & (1u << channel);
+}
+
+void dma_channel_acknowledge_irq0(uint channel)
+{
+	dma_hw->ints0 &= ~(1u << channel);
+}
+
+// Move the samples in the ADC FIFO with the busy channel paced by DREQ_ADC. At the end of a transfer, trigger
+// the chained channel and raise DMA_IRQ_0. The caller holds irq_lock.
+static void host_dma_adc(void)
+{
+	dma_channel_full_hw_t * ch;
+	uint32_t ctrl, size, ring;
+	uintptr_t address;
+	uint16_t sample;
+	uint channel, chain;
+
+	for (channel = 0; channel < HOST_DMA_CHANNELS; channel++)
+		if (dma_busy[channel] && host_dma_adc_paced(channel))
+			break;
+	if (channel >= HOST_DMA_CHANNELS)
+		return;
+	ch = &dma_hw->ch[channel];
+	ctrl = ch->ctrl_trig;
+	size = 1u << (ctrl >> HOST_DMA_SIZE_SHIFT & 3);
+	while (adc_fifo_level > 0 && dma_busy[channel]) {
+		sample = adc_fifo_get();
+		memcpy(dma_write[channel], &sample, size < 2 ? size : 2);
+		if (ctrl & HOST_DMA_INCR_WRITE) {
+			address = (uintptr_t)dma_write[channel];
+			ring = ctrl & HOST_DMA_RING_WRITE ? (1u << (ctrl >> HOST_DMA_RING_SHIFT & 0xF)) - 1 : 0;
+			if (ring)
+				address = (address & ~(uintptr_t)ring) | ((address + size) & ring);
+			else
+				address += size;
+			dma_write[channel] = (uint8_t *)address;
+			ch->write_addr = (uint32_t)address;
+		}
+		if (--ch->transfer_count == 0) {
+			dma_busy[channel] = false;
+			dma_hw->ints0 |= (1u << channel) & dma_hw->inte0;
+			chain = ctrl >> HOST_DMA_CHAIN_SHIFT & 0xF;
+			if (chain != channel) {
+				dma_channel_start(chain);
+				channel = chain;
+				ch = &dma_hw->ch[channel];
+				ctrl = ch->ctrl_trig;
+			}
+			if (dma_hw->ints0)
+				host_irq(DMA_IRQ_0);
+		}
+	}
+}
+
+// Flash
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+	if (flash_offs + count <= PICO_FLASH_SIZE_BYTES)
+		memset(host_flash + flash_offs, 0xFF, count);
+}
+
+// Programming can only change ones to zeros, as with the real flash.
+void flash_range_program(uint32_t flash_offs, const uint8_t * data, size_t count)
+{
+	size_t i;
+
+	if (flash_offs + count > PICO_FLASH_SIZE_BYTES)
+		return;
+	for (i = 0; i < count; i++)
+		host_flash[flash_offs + i] &= data[i];
+}
+
+// USB serial port and UART buffers
+
+static bool ring_put(struct host_ring * ring, uint8_t ch)
+{
+	bool room;
+
+	pthread_mutex_lock(&ring_lock);
+	room = ring->head - ring->tail < HOST_RING_SIZE;
+	if (room)
+		ring->data[ring->head++ & (HOST_RING_SIZE - 1)] = ch;
+	pthread_mutex_unlock(&ring_lock);
+	return room;
+}
+
+static int ring_get(struct host_ring * ring)
+{
+	int ch = -1;
+
+	pthread_mutex_lock(&ring_lock);
+	if (ring->head != ring->tail)
+		ch = ring->data[ring->tail++ & (HOST_RING_SIZE - 1)];
+	pthread_mutex_unlock(&ring_lock);
+	return ch;
+}
+
+bool stdio_init_all(void)
+{
+	return true;
+}
+
+// If the host does not read the port, the output is thrown away as the USB driver does.
+int putchar_raw(int c)
+{
+	ring_put(&usb_out, c);
+	return c;
+}
+
+void stdio_flush(void)
+{
+	fflush(stdout);
+}
+
+int getchar_timeout_us(uint32_t timeout_us)
+{
+	uint64_t end = time_us_64() + timeout_us;
+	int ch;
+
+	while ((ch = ring_get(&usb_in)) < 0) {
+		if (time_us_64() >= end)
+			return PICO_ERROR_TIMEOUT;
+		sleep_us(100);
+	}
+	return ch;
+}
+
+uint uart_init(uart_inst_t * uart, uint baudrate)
+{
+	return baudrate;
+}
+
+void uart_set_hw_flow(uart_inst_t * uart, bool cts, bool rts)
+{
+}
+
+void uart_set_format(uart_inst_t * uart, uint data_bits, uint stop_bits, uart_parity_t parity)
+{
+}
+
+void uart_set_fifo_enabled(uart_inst_t * uart, bool enabled)
+{
+}
+
+void uart_set_irq_enables(uart_inst_t * uart, bool rx_has_data, bool tx_needs_data)
+{
+	uart->rx_irq = rx_has_data;
+}
+
+bool uart_is_readable(uart_inst_t * uart)
+{
+	return uart->rx.head != uart->rx.tail;
+}
+
+char uart_getc(uart_inst_t * uart)
+{
+	int ch;
+
+	while ((ch = ring_get(&uart->rx)) < 0)
+		sleep_us(100);
+	return ch;
+}
+
+void uart_putc_raw(uart_inst_t * uart, char c)
+{
+	ring_put(&uart->tx, c);
+}
+
+void uart_puts(uart_inst_t * uart, const char * s)
+{
+	while (*s)
+		uart_putc_raw(uart, *s++);
+}
+
+void uart_write_blocking(uart_inst_t * uart, const uint8_t * src, size_t len)
+{
+	while (len--)
+		uart_putc_raw(uart, *src++);
+}
+
+// The threads
+
+static void * host_firmware_thread(void * arg)
+{
+	firmware_main();
+	return NULL;
+}
+
+static void * host_tick_thread(void * arg)
+{
+	repeating_timer_t * timer, * next;
+	uint64_t now, last = time_us_64();
+
+	while (1) {
+		sleep_us(HOST_TICK_US);
+		pthread_mutex_lock(&irq_lock);
+		now = time_us_64();
+		for (timer = timer_list; timer; timer = next) {
+			next = timer->next;
+			if (now < timer->next_us)
+				continue;
+			timer->next_us += timer->delay_us < 0 ? -timer->delay_us : timer->delay_us;
+			if (timer->next_us < now)	// the host was busy, so do not try to catch up
+				timer->next_us = now;
+			if ( ! (timer->callback)(timer))
+				cancel_repeating_timer(timer);
+		}
+		host_adc_tick(now - last);
+		last = now;
+		pthread_mutex_unlock(&irq_lock);
+	}
+	return NULL;
+}
+
+// These functions are called by the host program.
+
+// Start the firmware and the tick thread. Return 0, or -1 if it is already running or a thread can not start.
+int host_start(void)
+{
+	pthread_t thread;
+
+	if (host_running)
+		return -1;
+	host_running = true;
+	if (pthread_create(&thread, NULL, host_firmware_thread, NULL) != 0)
+		return -1;
+	pthread_detach(thread);
+	if (pthread_create(&thread, NULL, host_tick_thread, NULL) != 0)
+		return -1;
+	pthread_detach(thread);
+	return 0;
+}
+
+uint64_t host_time_us(void)
+{
+	return time_us_64();
+}
+
+// Return true if the firmware set up its I2C slave address.
+bool host_i2c_ready(void)
+{
+	return i2c_handler != NULL;
+}
+
+// Write length bytes to the I2C address. The first byte is the register number. Return the number of bytes
+// written, or -1 if no slave has this address.
+int host_i2c_write(uint8_t address, const uint8_t * data, int length)
+{
+	int i;
+
+	pthread_mutex_lock(&irq_lock);
+	if ( ! i2c_handler || address != i2c_address) {
+		pthread_mutex_unlock(&irq_lock);
+		return -1;
+	}
+	for (i = 0; i < length; i++) {
+		i2c_slave->data = data[i];
+		i2c_handler(i2c_slave, I2C_SLAVE_RECEIVE);
+	}
+	i2c_handler(i2c_slave, I2C_SLAVE_FINISH);
+	pthread_mutex_unlock(&irq_lock);
+	return length;
+}
+
+// Write the register number and then read length bytes with a restart. Return the number of bytes read,
+// or -1 if no slave has this address.
+int host_i2c_read(uint8_t address, uint8_t reg, uint8_t * data, int length)
+{
+	int i;
+
+	pthread_mutex_lock(&irq_lock);
+	if ( ! i2c_handler || address != i2c_address) {
+		pthread_mutex_unlock(&irq_lock);
+		return -1;
+	}
+	i2c_slave->data = reg;
+	i2c_handler(i2c_slave, I2C_SLAVE_RECEIVE);
+	i2c_handler(i2c_slave, I2C_SLAVE_FINISH);	// the restart
+	for (i = 0; i < length; i++) {
+		i2c_handler(i2c_slave, I2C_SLAVE_REQUEST);
+		data[i] = i2c_slave->data;
+	}
+	i2c_handler(i2c_slave, I2C_SLAVE_FINISH);
+	pthread_mutex_unlock(&irq_lock);
+	return length;
+}
+
+// Set the level on an input pin and call the GPIO interrupt for an enabled edge.
+void host_gpio_set_input(uint gpio, bool value)
+{
+	bool old;
+	uint32_t event;
+
+	if (gpio >= HOST_GPIO_COUNT)
+		return;
+	pthread_mutex_lock(&irq_lock);
+	old = gpio_get(gpio);
+	if (value)
+		gpio_in |= 1u << gpio;
+	else
+		gpio_in &= ~(1u << gpio);
+	if (old != gpio_get(gpio)) {
+		event = value ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+		if (gpio_callback && (gpio_irq_events[gpio] & event))
+			gpio_callback(gpio, event);
+	}
+	pthread_mutex_unlock(&irq_lock);
+}
+
+uint32_t host_gpio_get_all(void)
+{
+	return gpio_get_all();
+}
+
+// Return the PWM level of a pin, or -1 if the pin is not a PWM output.
+int host_pwm_get_level(uint gpio)
+{
+	uint32_t cc;
+
+	if (gpio >= HOST_GPIO_COUNT || gpio_function[gpio] != GPIO_FUNC_PWM)
+		return -1;
+	cc = pwm_hw->slice[pwm_gpio_to_slice_num(gpio)].cc;
+	return pwm_gpio_to_channel(gpio) == PWM_CHAN_A ? cc & 0xFFFF : cc >> 16;
+}
+
+// Set the 12-bit value of ADC channel 0 to 4. Channel 4 is the temperature sensor.
+void host_adc_set(uint channel, uint16_t value)
+{
+	if (channel < 5)
+		adc_input[channel] = value & 0x0FFF;
+}
+
+// Send bytes to the firmware on the USB serial port. Return the number of bytes accepted.
+int host_usb_write(const uint8_t * data, int length)
+{
+	int i;
+
+	for (i = 0; i < length; i++)
+		if ( ! ring_put(&usb_in, data[i]))
+			break;
+	return i;
+}
+
+// Read up to length bytes sent by the firmware on the USB serial port. Return the number of bytes read.
+int host_usb_read(uint8_t * data, int length)
+{
+	int i, ch;
+
+	for (i = 0; i < length && (ch = ring_get(&usb_out)) >= 0; i++)
+		data[i] = ch;
+	return i;
+}
+
+// Send bytes to the firmware on a UART and call the UART interrupt. Return the number of bytes accepted.
+int host_uart_write(uint index, const uint8_t * data, int length)
+{
+	uart_inst_t * uart = host_uart + (index & 1);
+	int i;
+
+	for (i = 0; i < length; i++)
+		if ( ! ring_put(&uart->rx, data[i]))
+			break;
+	pthread_mutex_lock(&irq_lock);
+	if (uart->rx_irq && i)
+		host_irq(UART0_IRQ + uart->index);
+	pthread_mutex_unlock(&irq_lock);
+	return i;
+}
+
+// Read up to length bytes sent by the firmware on a UART. Return the number of bytes read.
+int host_uart_read(uint index, uint8_t * data, int length)
+{
+	uart_inst_t * uart = host_uart + (index & 1);
+	int i, ch;
+
+	for (i = 0; i < length && (ch = ring_get(&uart->tx)) >= 0; i++)
+		data[i] = ch;
+	return i;
+}
@@ -8,7 +8,8 @@
 #define REG_CONTROL		5
 #define REG_INPUT_PINS		6
 #define REG_ANTENNA_TUNER	7
-#define REG_FAULT		8
+#define REG_FAULT		8	// protection fault bits, write FAULT_CLEAR to clear
+#define FAULT_CLEAR		0xA5
 
 #define REG_FIRMWARE_MAJOR	9
 #define REG_FIRMWARE_MINOR	10
@@ -37,6 +38,108 @@
 #define REG_ADC2_LSB		30
 #define REG_ANTENNA		31
 #define REG_OP_MODE		32
+#define REG_BANK		33	// the register bank in the window at REG_BANK_WINDOW, 0 for the plain registers
+#define REG_BANK_PAGE		34	// the page of the bank in the window
+#define REG_BANK_PAGES		35	// read only, the number of pages in the bank
+
+#define REG_AMP_POWER		36	// amplifier telemetry, read all four with one read
+#define REG_AMP_SWR		37
+#define REG_AMP_TEMP		38
+#define REG_AMP_STATUS		39
+#define REG_AMP_PRESELECT	40	// write 1 to change the amp band to follow the Rx frequency
+#define REG_AMP_BAND		41
+#define REG_PRESELECT_SAVED_MSB	42	// band change milliseconds removed from key-down
+#define REG_PRESELECT_SAVED_LSB	43
+
+#define REG_TUNE_TIME_MSB	44	// milliseconds of transmit for the last tune
+#define REG_TUNE_TIME_LSB	45
+#define REG_TUNE_SWR		46	// SWR times 10 at the end of the last tune, 0 if unknown
+
+#define REG_TUNER_CACHE		47	// 0 use tuner memories, 1 ignore them, 2 clear them
+
+#define REG_METER_FWD_MSB	48	// average forward power in 0.1 watts
+#define REG_METER_FWD_LSB	49
+#define REG_METER_SWR_MSB	50	// SWR times 100, 0 if no power
+#define REG_METER_SWR_LSB	51
+#define REG_METER_REV_MSB	52	// average reflected power in 0.1 watts
+#define REG_METER_REV_LSB	53
+#define REG_METER_PEAK_MSB	54	// peak-hold forward power in 0.1 watts
+#define REG_METER_PEAK_LSB	55
+#define REG_METER_PEP_MSB	56	// PEP forward power in 0.1 watts
+#define REG_METER_PEP_LSB	57
+#define REG_METER_HOLD		58	// peak hold and PEP time in units of 10 ms, 0 for 1 second
+#define REG_METER_DECAY		59	// peak decay of 1/2**N each 10 ms after the hold, 0 for N=2
+
+#define REG_PROTECT_SWR		60	// SWR times 10 limit, 0 for none
+#define REG_PROTECT_ADC0	61	// ADC limits, the upper 8 bits of the 12-bit value, 0 for none
+#define REG_PROTECT_ADC1	62
+#define REG_PROTECT_ADC2	63
+#define REG_PROTECT_OUTPUTS	64	// outputs to drive low on a fault, bits as REG_OUT_PINS
+#define REG_PROTECT_COUNT	65	// number of samples over the limit for a fault, 0 for 1
+#define REG_PROTECT_TRIP_US_MSB	66	// microseconds from the ADC interrupt to the outputs low
+#define REG_PROTECT_TRIP_US_LSB	67
+
+#define REG_CAPTURE_CONTROL	68	// write 1 to arm, 0 to cancel; 2 is capturing, 3 is done
+#define REG_CAPTURE_CHANNEL	69	// ADC channel 0 to 2
+#define REG_CAPTURE_RATE_MSB	70	// samples per second in units of 10, 0 for the highest
+#define REG_CAPTURE_RATE_LSB	71
+#define REG_CAPTURE_PRETRIGGER	72	// samples before the trigger in units of 16, 0 for 1024
+#define REG_CAPTURE_PEAK_MSB	73	// maximum ADC sample
+#define REG_CAPTURE_PEAK_LSB	74
+#define REG_CAPTURE_PEAK_TIME_MSB	75	// signed microseconds from the trigger to the peak
+#define REG_CAPTURE_PEAK_TIME_LSB	76
+#define REG_CAPTURE_PEP_MSB	77	// PEP of the envelope in 0.1 watts
+#define REG_CAPTURE_PEP_LSB	78
+#define REG_CAPTURE_OVERSHOOT	79	// envelope peak over the final level in percent
+
+#define REG_FILTER_ADC0_MSB	80	// filtered and calibrated 16-bit ADC values
+#define REG_FILTER_ADC0_LSB	81
+#define REG_FILTER_ADC1_MSB	82
+#define REG_FILTER_ADC1_LSB	83
+#define REG_FILTER_ADC2_MSB	84
+#define REG_FILTER_ADC2_LSB	85
+#define REG_FILTER_RATE		86	// decimation 2**N, ADC0 N in the low 4 bits, ADC1 N in the high 4 bits, 0 for N=6
+#define REG_FILTER_CONTROL	87	// ADC2 N in the low 4 bits, 0x10 CIC order 2, 0x20 save calibration, 0x40 clear calibration, 0x80 zero offsets
+
+#define REG_FAN_CONTROL		88	// mode in the low 3 bits, 0x10 tach enable, 0x80 fan stall
+#define REG_FAN_SETPOINT	89	// start the fan at this temperature in degrees C
+#define REG_FAN_GAIN		90	// duty cycle steps per degree C
+#define REG_FAN_MIN		91	// minimum duty cycle while the fan runs
+#define REG_FAN_HYSTERESIS	92	// stop the fan this many degrees C below the setpoint
+#define REG_FAN_TEMP		93	// temperature in degrees C
+#define REG_FAN_RPM_MSB		94	// fan RPM from the tach
+#define REG_FAN_RPM_LSB		95
+
+#define REG_BAND_VOLTS_MSB	96	// J4 pin 8 millivolts, write the LSB to set the voltage
+#define REG_BAND_VOLTS_LSB	97
+#define REG_BAND_VOLTS_STANDARD	98	// 1 FT-817, 2 Xiegu, 3 Icom, 0 for the firmware default
+#define REG_BAND_VOLTS_CAL	99	// write 1 to add a calibration point, 2 to clear the calibration
+#define REG_BAND_VOLTS_MEASURED_MSB	100	// measured millivolts for a calibration point
+#define REG_BAND_VOLTS_MEASURED_LSB	101
+#define REG_BAND_VOLTS_CODE_MSB	102	// the 14-bit output code
+#define REG_BAND_VOLTS_CODE_LSB	103
+
+#define REG_TRACE_CONTROL	104	// 0x01 enable the trace, 0x02 trace register writes, write 0x80 to clear
+#define REG_TRACE_SEQ_MSB	105	// sequence number of the next trace record, read the MSB first
+#define REG_TRACE_SEQ_LSB	106
+#define REG_TRACE_SIZE		110	// log2 of the number of records in the trace
+
+#define REG_STATS_CONTROL	112	// write 1 to snapshot the performance counters, 2 to snapshot and clear them
+#define REG_STATS_COUNT		113	// read only, the number of counters in the snapshot
+#define REG_STATS_LATENCY_MSB	114	// last microseconds from the Tx frequency write to the outputs applied
+#define REG_STATS_LATENCY_LSB	115
+
+#define REG_CHANGE_SEQ_MSB	116	// change counter, a read of the MSB copies the counter and bitmap and clears the bitmap
+#define REG_CHANGE_SEQ_LSB	117
+#define REG_DIRTY_MSB		118	// bit n is set if a register in 16 * (n + 8) to 16 * (n + 8) + 15 changed
+#define REG_DIRTY_LSB		119	// bit n is set if a register in 16 * n to 16 * n + 15 changed
+
+#define REG_TELEMETRY		120	// USB telemetry frames, 0x01 registers, 0x02 ADC, 0x04 trace, 0x08 counters
+#define REG_TELEMETRY_ADC_DIVIDE	121	// send one of this many ADC samples
+#define REG_TELEMETRY_STATS_PERIOD	122	// send the counters every this many 100 milliseconds, 0 for one second
+#define REG_TELEMETRY_DROPPED	123	// ADC samples thrown away because the USB port was too slow
+
+#define REG_BANK_WINDOW		128	// BANK_WINDOW_SIZE registers of bank data when REG_BANK is not zero
 
 #define REG_STATUS		167
 #define REG_IN_PINS		168
@@ -4,7 +4,9 @@
 //   Copyright (c) 2024 Glitsun Cheeran <glitsun@gmail.com>.
 //   It is licensed under the MIT license. See MIT.txt.
 
-// This firmware uses the SPE Expert serial port commands to do band changes
+// This firmware uses the SPE Expert serial port commands to do band changes.
+// It also polls the SPE Expert binary status protocol on a second UART and
+// publishes the amplifier telemetry in registers REG_AMP_POWER to REG_AMP_STATUS.
 
 #include "../hl2ioboard.h"
 #include "../i2c_registers.h"
@@ -19,11 +21,17 @@
 #define STOP_BITS 1
 #define PARITY UART_PARITY_NONE
 
+// The SPE Expert PC port uses the binary status protocol on UART1, J4 pin 3 and J8 pin 3.
+#define SPE_UART_ID uart1
+#define SPE_BAUD_RATE 115200
+#define SPE_POLL_MS 250		// Request the amplifier status this often
+#define SPE_TIMEOUT_MS 2000	// Clear the telemetry if there is no valid status for this long
+
 #define DEBUG false
 
 // These are the major and minor version numbers for firmware. You must set these.
 uint8_t firmware_version_major=1;
-uint8_t firmware_version_minor=1;
+uint8_t firmware_version_minor=2;
 
 
 uint8_t response[256] = "";
@@ -117,6 +125,177 @@ void on_uart_rx() {
 	}
 }
 
+// The SPE Expert binary status protocol. The status request is 0x55 0x55 0x55 0x01 0x90 0x90.
+// The response is 0xAA 0xAA 0xAA, a count of 67, 67 bytes of comma separated ASCII fields,
+// a two byte checksum and "\r\n". The data starts and ends with a comma, for example
+// ",13K,S,R,A,1,10,1a,0r,L,0000, 0.00, 0.00, 0.0, 0.0,033,000,000,N,N,". The checksum is
+// the sum of the data bytes, low byte first.
+// The response is parsed one byte at a time in the UART interrupt, and the finished packet
+// is decoded in the main loop.
+
+#define SPE_SYNC_TX	0x55
+#define SPE_SYNC_RX	0xAA
+#define SPE_CMD_STATUS	0x90
+#define SPE_MAX_DATA	80
+
+enum spe_state {SPE_SYNC1, SPE_SYNC2, SPE_SYNC3, SPE_COUNT, SPE_DATA, SPE_CHK0, SPE_CHK1};
+
+char spe_packet[SPE_MAX_DATA + 1];	// the last good status packet
+volatile bool spe_packet_ready = false;
+uint32_t spe_bad_checksums = 0;
+
+void spe_request_status() {
+	static const uint8_t cmd[6] = {SPE_SYNC_TX, SPE_SYNC_TX, SPE_SYNC_TX, 0x01, SPE_CMD_STATUS, SPE_CMD_STATUS};
+
+	uart_write_blocking(SPE_UART_ID, cmd, sizeof(cmd));
+}
+
+// RX interrupt handler for the SPE binary protocol
+void on_spe_rx() {
+	static uint8_t state = SPE_SYNC1;
+	static uint8_t count, index;
+	static uint16_t checksum;
+	static char data[SPE_MAX_DATA];
+
+	while (uart_is_readable(SPE_UART_ID)) {
+		uint8_t ch = uart_getc(SPE_UART_ID);
+		switch (state) {
+		case SPE_SYNC1:
+		case SPE_SYNC2:
+		case SPE_SYNC3:
+			if (ch == SPE_SYNC_RX)
+				state++;
+			else
+				state = SPE_SYNC1;
+			break;
+		case SPE_COUNT:
+			if (ch == SPE_SYNC_RX) {	// more than three sync bytes, stay here
+				break;
+			}
+			if (ch == 0 || ch > SPE_MAX_DATA) {
+				state = SPE_SYNC1;
+				break;
+			}
+			count = ch;
+			index = 0;
+			checksum = 0;
+			state = SPE_DATA;
+			break;
+		case SPE_DATA:
+			data[index++] = ch;
+			checksum += ch;
+			if (index >= count)
+				state = SPE_CHK0;
+			break;
+		case SPE_CHK0:
+			if (ch == (checksum & 0xFF))
+				state = SPE_CHK1;
+			else {
+				spe_bad_checksums++;
+				state = SPE_SYNC1;
+			}
+			break;
+		case SPE_CHK1:
+			if (ch == (checksum >> 8) && ! spe_packet_ready) {	// the main loop has finished with the last packet
+				memcpy(spe_packet, data, count);
+				spe_packet[count] = '\0';
+				spe_packet_ready = true;
+			}
+			else if (ch != (checksum >> 8)) {
+				spe_bad_checksums++;
+			}
+			state = SPE_SYNC1;	// ignore the trailing "\r\n"
+			break;
+		}
+	}
+}
+
+// Convert a decimal field such as "1.35" or "0500" to an integer times ten.
+uint32_t spe_field_x10(const char *field) {
+	uint32_t value = 0;
+
+	while (*field == ' ')
+		field++;
+	while (*field >= '0' && *field <= '9')
+		value = value * 10 + *field++ - '0';
+	value *= 10;
+	if (*field == '.' && field[1] >= '0' && field[1] <= '9')
+		value += field[1] - '0';
+	return value;
+}
+
+// Decode a status packet and publish it to the REG_AMP registers.
+// After the leading comma, the fields are: ID, Standby/Operate, Rx/Tx, Memory bank, Input, Band,
+// Tx antenna, Rx antenna, Power level, Output power, SWR ATU, SWR antenna, PA volts, PA amps,
+// Temp upper, Temp lower, Temp combiner, Warning, Alarm.
+bool spe_publish_status(char *packet) {
+	char *field[19];
+	uint8_t nfields = 0, temp, status;
+	uint32_t value;
+	char *pt = packet;
+
+	if (*pt == ',')		// skip the leading comma so that field[0] is the ID
+		pt++;
+	field[nfields++] = pt;
+	for ( ; *pt && nfields < 19; pt++) {
+		if (*pt == ',') {
+			*pt = '\0';
+			field[nfields++] = pt + 1;
+		}
+	}
+	if (nfields < 19)
+		return false;
+	value = (spe_field_x10(field[9]) + 50) / 100;	// output power in units of ten watts
+	Registers[REG_AMP_POWER] = value > 255 ? 255 : value;
+	value = spe_field_x10(field[11]);		// antenna SWR times ten
+	Registers[REG_AMP_SWR] = value > 255 ? 255 : value;
+	temp = 0;
+	for (int i = 14; i <= 16; i++) {		// the highest temperature in degrees C
+		value = spe_field_x10(field[i]) / 10;
+		if (value > temp)
+			temp = value > 255 ? 255 : value;
+	}
+	Registers[REG_AMP_TEMP] = temp;
+	status = 0;
+	if (field[1][0] == 'O')
+		status |= 0x01;		// operate
+	if (field[2][0] == 'T')
+		status |= 0x02;		// transmit
+	if (field[17][0] != 'N')
+		status |= 0x40;		// warning
+	if (field[18][0] != 'N')
+		status |= 0x80;		// alarm
+	Registers[REG_AMP_STATUS] = status;
+	return true;
+}
+
+void spe_clear_status() {
+	Registers[REG_AMP_POWER] = 0;
+	Registers[REG_AMP_SWR] = 0;
+	Registers[REG_AMP_TEMP] = 0;
+	Registers[REG_AMP_STATUS] = 0;
+}
+
+void spe_poll() {
+	static absolute_time_t poll_time, status_time;
+
+	if (spe_packet_ready) {
+#if DEBUG
+		printf("status: %s\n", spe_packet);
+#endif
+		if (spe_publish_status(spe_packet))
+			status_time = get_absolute_time();
+		spe_packet_ready = false;
+	}
+	else if (absolute_time_diff_us(status_time, get_absolute_time()) / 1000 >= SPE_TIMEOUT_MS) {
+		spe_clear_status();	// the amplifier is off or not connected
+		status_time = get_absolute_time();
+	}
+	if (absolute_time_diff_us(poll_time, get_absolute_time()) / 1000 >= SPE_POLL_MS) {
+		spe_request_status();
+		poll_time = get_absolute_time();
+	}
+}
 
 int main()
 {
@@ -145,6 +324,18 @@ int main()
 
 	// Now enable the UART to send interrupts - RX only
 	uart_set_irq_enables(UART_ID, true, false);
+
+	// The second UART reads the amplifier status
+	gpio_set_function(GPIO20_Out3, GPIO_FUNC_UART);	// UART1 TX
+	gpio_set_function(GPIO21_In3, GPIO_FUNC_UART);	// UART1 RX
+	uart_init(SPE_UART_ID, SPE_BAUD_RATE);
+	uart_set_hw_flow(SPE_UART_ID, false, false);
+	uart_set_format(SPE_UART_ID, DATA_BITS, STOP_BITS, PARITY);
+	uart_set_fifo_enabled(SPE_UART_ID, true);
+	irq_set_exclusive_handler(UART1_IRQ, on_spe_rx);
+	irq_set_enabled(UART1_IRQ, true);
+	uart_set_irq_enables(SPE_UART_ID, true, false);
+
 	while (1) {	// Wait for something to happen
 		sleep_ms(1);	// This sets the polling frequency.
 		// Poll for a changed Tx frequency. The new_tx_freq is set in the I2C handler.
@@ -152,5 +343,6 @@ int main()
 			current_tx_freq = new_tx_freq;
 			spe_change_frequency(new_tx_freq);
 		}
+		spe_poll();
     }
 }
\ No newline at end of file
@@ -10,7 +10,6 @@
 #include "../i2c_registers.h"
 #include "hardware/uart.h"
 #include <string.h>
-#include <math.h>
 
 #define UART_ID uart0
 #define BAUD_RATE 19200
@@ -78,9 +77,13 @@ void clear_response() {
 	response_ok = false;
 }
 
+absolute_time_t serial_time;	// the time of the last serial traffic
+
 void uart_puts_log(uart_inst_t *uart, const char *s) {
 	clear_response();
 	uart_puts(uart, s);
+	serial_time = get_absolute_time();
+	stats_count(STATS_UART_TX);
 #if DEBUG
 	printf("sent: %s\n", s);
 #endif
@@ -97,6 +100,7 @@ void on_uart_rx() {
 			clear_response();
 		}
 		uint8_t ch = uart_getc(UART_ID);
+		serial_time = get_absolute_time();
 		size_t len = strlen(response);
 		if (len < 255) {
 			strncat(response, &ch, 1);
@@ -115,6 +119,7 @@ void on_uart_rx() {
 				response_ok = false;
 			}
 			response_ready = true;
+			stats_count(STATS_UART_RX);
 		}
 	}
 }
@@ -123,6 +128,7 @@ void hr50_change_band(uint8_t hr50_band) {
 	char cmd[30];
 	sprintf(cmd, "HRBN%d;", hr50_band);
 	uart_puts_log(UART_ID, cmd);
+	uart_puts(UART_ID, "HRBN;");	// query the band so the change is confirmed
 }
 
 // void hr50_change_freq(uint64_t hr50_freq) {
@@ -158,44 +164,31 @@ uint8_t handle_serial_response(char *expected_response, char *next_command[2]) {
 	return status;
 }
 
-// Calculate SWR as a rolling average of the last k samples
-// Return zero if we determine that transmit voltage readings aren't available
-double read_swr() {
-	const double conversion_factor = 3.3 / (1 << 12);
-	const double k = 10.0;
-	double v_rev, v_fwd, ratio, swr;
-	static double avg_swr = 5.0;
-
-	adc_select_input(0);
-	v_rev = adc_read() * conversion_factor;
-	adc_select_input(1);
-	v_fwd = adc_read() * conversion_factor;
-	if (v_rev > v_fwd) {
-		// This should never happen, and probably means that the transmit voltage readings
-		// aren't available because they haven't been wired up.
-		avg_swr = 0.0;
-	} else {
-		if (v_fwd < 0.0001) v_fwd = 0.0001;
-		ratio = v_rev / v_fwd;
-		if (ratio > 0.9999) ratio = 0.9999;
-		swr = (1 + ratio)/(1 - ratio);
-		avg_swr = ((avg_swr * (k - 1.0)) + swr) / k;
-	}
-	return avg_swr;
-}
+// The settle detector ends the tune transmission as soon as the SWR from the HL2 is stable.
+// SWR values are SWR times 100.
+static const struct swr_settle_config settle_config = {
+	.interval_ms = 50,	// add the SWR to the detector window every 50 ms
+	.slope_max = 10,	// the SWR changed by at most 0.1 across the window
+	.variance_max = 25,	// standard deviation of at most 0.05
+	.swr_max = 200,		// a stable SWR of 2.0 or less is a match
+	.stable_ms = 1000,	// a stable higher SWR means the tuner gave up
+	.min_ms = 300,
+};
 
 uint8_t console_in[256] = "";
+static uint8_t state_antenna_tuner = 0;
+
+// The ATU has its own memories. If the tuner cache has a successful tune for this frequency and antenna,
+// report success without a tune cycle. This needs the ATU to be active, not bypassed. See tuner_cache.c.
 
 void hr50_tune() {
-	static uint8_t state_antenna_tuner = 0;
 #if DEBUG
 	static uint8_t tuner_reg_value = 255, old_state_antenna_tuner = 255;
 #endif
+	static uint8_t traced_state = 0;
 	static absolute_time_t tuner_time0, tuner_time1;
-	uint8_t reg;
-
-	static double swr, last_swr = 100.0;
-	static absolute_time_t last_swr_change_time, last_log_time;
+	bool settled;
+	static absolute_time_t last_log_time;
 
 #if DEBUG
 	if (response_ready == true) {
@@ -234,13 +227,15 @@ void hr50_tune() {
 		state_antenna_tuner = 0;
 		Registers[REG_ANTENNA_TUNER] = 0xF0;
 	}
+	if (state_antenna_tuner != traced_state) {	// record state changes in the trace
+		traced_state = state_antenna_tuner;
+		trace_event(TRACE_STATE, REG_ANTENNA_TUNER, state_antenna_tuner);
+	}
 	switch (state_antenna_tuner) {
-	case 0:		// Check the I2C register. 1 is start tuning, 2 is bypass mode.
-		reg = Registers[REG_ANTENNA_TUNER];
-		if (reg == 1 || reg == 2) {
-			state_antenna_tuner = reg;
+	case 0:		// Check the I2C register. 1 is start tuning, 2 is bypass mode, 3 is tune without the tuner cache.
+		state_antenna_tuner = tuner_cache_tune_request();
+		if (state_antenna_tuner)
 			tuner_time0 = get_absolute_time();
-		}
 		break;
 	case 1: 	// Start tuning
 		// Set ATU active
@@ -263,6 +258,7 @@ void hr50_tune() {
 			char *cmd[2] = {"",""};
 			uint8_t status = handle_serial_response("HRAT1;", cmd);
 			if (status == RESPONSE_GOOD) {
+				tuner_cache_bypass();
 				state_antenna_tuner = 0;
 				Registers[REG_ANTENNA_TUNER] = state_antenna_tuner;
 			} else if (status == RESPONSE_BAD) {
@@ -320,8 +316,8 @@ void hr50_tune() {
 				Registers[REG_ANTENNA_TUNER] = 0xF4;
 			} else {
 				state_antenna_tuner = 8;
-				tuner_time1 = last_swr_change_time = last_log_time = get_absolute_time();
-				last_swr = 100.0;
+				tuner_time1 = last_log_time = get_absolute_time();
+				swr_settle_start(&settle_config);
 			}
 		}
 		break;
@@ -329,28 +325,24 @@ void hr50_tune() {
 		// We can't communicate with the amp while it's transmitting.
 		// Instead, we can monitor SWR from the HL2 if it's available, or wait for a fixed amount of time.
 		// In my testing, tuning seems to either succeed or fail in less than 5 seconds.
-		swr = read_swr();
-		if (swr < 1.0 || fabs((swr - last_swr)/last_swr) > 0.1) {
-			// Either swr changed by > 10%, or we got a bad reading.
-			// SWR less less than one indicates we can't trust it, so we update last_swr_change_time
-			// which means it will never appear to stabilize and we'll revert to timed transmit.
-			last_swr_change_time = get_absolute_time();
-			last_swr = swr;
-		}
+		// If the SWR readings are not valid, the settle detector never settles and we revert to timed transmit.
+		settled = swr_settle_poll();
 #if DEBUG
 		if ((absolute_time_diff_us(last_log_time, get_absolute_time()) / 1000 >= 100)) {
-			printf("%5d swr: %7.2f last_swr: %7.2f last_swr_change_time: %5d delta: %5d\n",
+			printf("%5d swr: %d.%02d\n",
 				(uint32_t)(absolute_time_diff_us(tuner_time1, get_absolute_time()) / 1000),
-				swr,
-				last_swr,
-				(uint32_t)(absolute_time_diff_us(tuner_time1, last_swr_change_time) / 1000),
-				(uint32_t)(absolute_time_diff_us(last_swr_change_time, get_absolute_time()) / 1000));
+				swr_x100() / 100, swr_x100() % 100);
 			last_log_time = get_absolute_time();
 		}
 #endif
-		if (absolute_time_diff_us(last_swr_change_time, get_absolute_time()) / 1000 >= 1000 ||
-			absolute_time_diff_us(tuner_time1, get_absolute_time()) / 1000 >= 5000) {
-			// Turn off transmitter if SWR has stabilized for one second or five seconds has elapsed
+		if (settled || absolute_time_diff_us(tuner_time1, get_absolute_time()) / 1000 >= 5000) {
+			// Turn off transmitter if SWR has settled or five seconds has elapsed
+			swr_settle_finish();	// log the tune time and SWR
+			tuner_cache_tune_swr(Registers[REG_TUNE_SWR]);
+#if DEBUG
+			printf("tune time %d ms swr x10 %d %s\n", Registers[REG_TUNE_TIME_MSB] << 8 | Registers[REG_TUNE_TIME_LSB],
+				Registers[REG_TUNE_SWR], settled ? "settled" : "timeout");
+#endif
 			state_antenna_tuner = 9;
 			Registers[REG_ANTENNA_TUNER] = state_antenna_tuner;
 			tuner_time1 = get_absolute_time();
@@ -381,16 +373,58 @@ void hr50_tune() {
 		}
 		break;
 	}
+	tuner_cache_tune_poll(state_antenna_tuner);
+}
+
+// The amp band follows the Tx frequency, and with REG_AMP_PRESELECT the Rx frequency. See amp_band.c.
+#define SERIAL_IDLE_MS 200		// the serial port must be quiet for this long
+
+bool serial_idle() {
+	return state_antenna_tuner == 0 &&
+		absolute_time_diff_us(serial_time, get_absolute_time()) / 1000 >= SERIAL_IDLE_MS;
 }
 
+// Return true when the amp answers the band query sent by hr50_change_band() with this band.
+bool hr50_band_ack(uint8_t hr50_band) {
+	char expected[30];
+	char *cmd[2] = {"",""};
+
+	if (state_antenna_tuner)	// the response is for the tuner
+		return false;
+	sprintf(expected, "HRBN%d;", hr50_band);
+	return handle_serial_response(expected, cmd) == RESPONSE_GOOD;
+}
+
+static const struct amp_band_config amp_config = {
+	.fcode2band = fcode2hr50_band,
+	.change_band = hr50_change_band,
+	.band_ack = hr50_band_ack,
+	.serial_idle = serial_idle,
+	.band_unknown = 99,
+};
+
 int main()
 {
 	uint8_t current_tx_fcode = 0;
 	uint8_t hr50_band = 99;
 
 	stdio_init_all();
+	flash_store_init();	// restore the tuner memories before the I2C bus starts
+	tuner_cache_load();
 	configure_pins(true, false);
 	configure_led_flasher();
+	amp_band_start(&amp_config);
+	trace_start();
+	stats_start();
+	change_track_start();
+	adc_stream_start(1 << 0 | 1 << 1 | 1 << 4, 10000);	// ADC0 is reverse and ADC1 is forward voltage, 4 is temperature
+	protect_start(0, 1, 0);	// the protection check must be first
+	swr_estimator_start(0, 1);
+	meter_start(0, 1);
+	adc_filter_start();
+	fan_control_start();
+	telemetry_start();
+	capture_init();
 
    	uart_init(UART_ID, BAUD_RATE);
   	uart_set_hw_flow(UART_ID, false, false);
@@ -426,9 +460,18 @@ int main()
 			// We convert the frequency code to an HR50 band code, taking
 			// into account the frequency ranges associated with each code.
 			hr50_band = fcode2hr50_band(current_tx_fcode);
-			hr50_change_band(hr50_band);
+			amp_band_tx(hr50_band);
+			stats_outputs_applied();
 		}
+		amp_band_poll();
 
+		tuner_cache_poll();
 		hr50_tune();
+		flash_store_poll();
+		change_track_poll();
+		telemetry_poll();
+		usb_command_poll();
+		capture_poll();
+		adc_filter_poll();
 	}
 }
\ No newline at end of file
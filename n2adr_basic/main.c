@@ -23,14 +23,28 @@ int main()
 	uint8_t i;
 
 	stdio_init_all();
+	flash_store_init();	// read the band voltage calibration
 	configure_pins(false, true);
 	configure_led_flasher();
+	band_volts_start();
+	capture_init();
+	trace_start();
+	stats_start();
+	change_track_start();
+	telemetry_start();
+	fan_control_start();
 
 	while (1) {	// Wait for something to happen
 		sleep_ms(1);	// This sets the polling frequency.
 		// Control the Icom AH-4 antenna tuner.
 		// Assume the START line is on J4 pin 6 and the KEY line is on J8 pin 2.
 		IcomAh4(GPIO22_Out6, GPIO18_In2);
+		capture_poll();
+		band_volts_poll();
+		flash_store_poll();
+		change_track_poll();
+		telemetry_poll();
+		usb_command_poll();
 		// Poll for a changed Tx band, Rx band and T/R change
 		change_band = false;
 		is_rx = gpio_get(GPIO13_EXTTR);		// true for receive, false for transmit
@@ -43,7 +57,8 @@ int main()
 			current_tx_fcode = new_tx_fcode;
 			change_band = true;
 			tx_band = fcode2band(current_tx_fcode);		// Convert the frequency code to a band code.
-			ft817_band_volts(tx_band);			// Put the band voltage on J4 pin 8.
+			band_volts_band(tx_band, BAND_VOLTS_FT817);	// Put the band voltage on J4 pin 8.
+			trace_event(TRACE_BAND, REG_TX_FREQ_BYTE0, tx_band);
 		}
 		// Poll for a change in one of the twelve Rx frequencies. The rx_freq_changed is set in the I2C handler.
 		if (rx_freq_changed) {
@@ -84,6 +99,7 @@ int main()
 				gpio_put(GPIO19_Out2, 0);
 				gpio_put(GPIO20_Out3, 0);
 			}
+			stats_outputs_applied();
 		}
 	}
 }
@@ -0,0 +1,173 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This is a decimation filter for ADC0 to ADC2 in the ADC stream. Each channel is decimated by 2**N, where N
+// is a four bit value in REG_FILTER_RATE (ADC0 low bits, ADC1 high bits) and REG_FILTER_CONTROL (ADC2 low bits).
+// Zero means N=6. The filter is a boxcar, or a second order CIC filter if REG_FILTER_CONTROL bit 4 is set.
+// Averaging 4**B samples adds B bits of resolution if there is enough noise, so N=4 gives 14 bits and N=8 gives
+// 16 bits. The output is scaled to 16 bits, so full scale is 65535 for any rate.
+//
+// The filter does one addition for each sample in the ADC interrupt, and the offset and gain calibration
+// is only applied when a 16-bit result is read. The calibration is kept in the flash store. With the inputs at
+// zero volts, write bit 7 of REG_FILTER_CONTROL to use the current values as the offsets and save them.
+// Write bit 6 to clear the calibration. The calibration can also be read and written as register bank
+// BANK_FILTER_CAL: four bytes for each channel, the signed offset and then the gain, least significant byte
+// first. Bank writes take effect at once, and writing bit 5 of REG_FILTER_CONTROL saves them.
+// Call adc_filter_start() after the flash store is ready and adc_filter_poll() in the polling loop.
+
+#include <string.h>
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+#define FILTER_LOG2_DEFAULT	6
+#define FILTER_GAIN_ONE		32768	// gain of 1.0
+
+struct filter_state {
+	uint32_t integrator1, integrator2;
+	uint32_t last_integrator2, last_comb;
+	uint16_t count;
+	uint8_t log2;		// decimation is 2**log2
+	bool order2;		// second order CIC
+};
+
+struct filter_calibration {
+	int16_t offset;		// subtracted from the 16-bit value
+	uint16_t gain;		// 32768 is a gain of 1.0, zero is not calibrated
+};
+
+static struct filter_state FilterState[3];
+static struct filter_calibration FilterCal[3];
+static volatile uint16_t filter_raw[3];	// the latest uncalibrated 16-bit values
+
+// Read the decimation rate and order for this channel from the registers.
+static void filter_config(uint8_t channel, uint8_t * log2, bool * order2)
+{
+	uint8_t n;
+
+	if (channel == 0)
+		n = Registers[REG_FILTER_RATE] & 0x0F;
+	else if (channel == 1)
+		n = Registers[REG_FILTER_RATE] >> 4;
+	else
+		n = Registers[REG_FILTER_CONTROL] & 0x0F;
+	*order2 = (Registers[REG_FILTER_CONTROL] & 0x10) != 0;
+	if (n == 0)
+		n = FILTER_LOG2_DEFAULT;
+	if (*order2 && n > 10)		// the CIC gain must fit in 32 bits
+		n = 10;
+	*log2 = n;
+}
+
+// This is called from the ADC interrupt for each sample.
+static void adc_filter_handler(uint8_t channel, uint16_t sample)
+{
+	struct filter_state * f;
+	uint32_t y, comb;
+	uint8_t shift, log2;
+	bool order2;
+
+	if (channel > 2)
+		return;
+	f = FilterState + channel;
+	f->integrator1 += sample;
+	if (f->order2)
+		f->integrator2 += f->integrator1;
+	if (++f->count < (1 << f->log2))
+		return;
+	f->count = 0;
+	if (f->order2) {
+		comb = f->integrator2 - f->last_integrator2;
+		f->last_integrator2 = f->integrator2;
+		y = comb - f->last_comb;
+		f->last_comb = comb;
+		shift = f->log2 * 2;
+	}
+	else {
+		y = f->integrator1;
+		f->integrator1 = 0;
+		shift = f->log2;
+	}
+	// Scale from 12 bits times the filter gain to 16 bits
+	y = shift >= 4 ? y >> (shift - 4) : y << (4 - shift);
+	filter_raw[channel] = y > 0xFFFF ? 0xFFFF : y;
+	filter_config(channel, &log2, &order2);
+	if (log2 != f->log2 || order2 != f->order2) {	// start again with the new rate
+		memset(f, 0, sizeof(struct filter_state));
+		f->log2 = log2;
+		f->order2 = order2;
+	}
+}
+
+static void adc_filter_save(void)
+{
+	flash_store_write(FLASH_KEY_ADC_CAL, FilterCal, sizeof(FilterCal));
+}
+
+// Start the filter. The calibration is read from the flash store.
+void adc_filter_start(void)
+{
+	uint8_t channel;
+
+	memset(FilterCal, 0, sizeof(FilterCal));
+	flash_store_read(FLASH_KEY_ADC_CAL, FilterCal, sizeof(FilterCal));
+	for (channel = 0; channel < 3; channel++) {
+		memset(FilterState + channel, 0, sizeof(struct filter_state));
+		filter_config(channel, &FilterState[channel].log2, &FilterState[channel].order2);
+	}
+	adc_stream_add_handler(adc_filter_handler);
+	bank_register(BANK_FILTER_CAL, FilterCal, sizeof(FilterCal), true);
+}
+
+// Return the calibrated 16-bit value of this channel.
+uint16_t adc_filter_value(uint8_t channel)
+{
+	struct filter_calibration * cal = FilterCal + channel;
+	int32_t value;
+
+	value = (int32_t)filter_raw[channel] - cal->offset;
+	if (cal->gain)
+		value = value * cal->gain / FILTER_GAIN_ONE;
+	if (value < 0)
+		return 0;
+	return value > 0xFFFF ? 0xFFFF : value;
+}
+
+// Set the calibration of this channel and save it. The gain is 32768 for 1.0.
+void adc_filter_set_calibration(uint8_t channel, int16_t offset, uint16_t gain)
+{
+	FilterCal[channel].offset = offset;
+	FilterCal[channel].gain = gain;
+	adc_filter_save();
+}
+
+// Copy the value of a channel to its registers. This is called from the I2C handler.
+void adc_filter_registers(uint8_t channel)
+{
+	uint16_t value = adc_filter_value(channel);
+
+	Registers[REG_FILTER_ADC0_MSB + channel * 2] = value >> 8;
+	Registers[REG_FILTER_ADC0_LSB + channel * 2] = value & 0xFF;
+}
+
+// Call this in the polling loop to perform calibration requests.
+void adc_filter_poll(void)
+{
+	uint8_t control = Registers[REG_FILTER_CONTROL];
+	int channel;
+
+	if (control & 0x80) {		// the inputs are at zero volts
+		for (channel = 0; channel < 3; channel++)
+			FilterCal[channel].offset = filter_raw[channel];
+		adc_filter_save();
+	}
+	else if (control & 0x40) {	// clear the calibration
+		memset(FilterCal, 0, sizeof(FilterCal));
+		adc_filter_save();
+	}
+	else if (control & 0x20) {	// save the calibration written to the bank
+		adc_filter_save();
+	}
+	if (control & 0xE0)
+		Registers[REG_FILTER_CONTROL] = control & 0x1F;
+}
@@ -0,0 +1,308 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This runs the ADC continuously in the background. The ADC converts the channels in channel_mask in turn,
+// and an interrupt reads each sample from the ADC FIFO. The latest sample for each channel is kept in
+// adc_stream_latest[], and each sample is passed to the handlers added with adc_stream_add_handler().
+// The handlers are called from the interrupt, so they must return quickly.
+// While the stream runs, the I2C handler returns the latest samples for REG_ADC0_MSB to REG_ADC2_LSB
+// instead of starting a conversion.
+//
+// For a capture, adc_stream_fast_start() runs the ADC at up to 500,000 samples per second with DMA. Two DMA
+// channels take turns writing blocks of samples, and the DMA interrupt passes every sample of a finished block
+// to the fast handler. The stream channels are converted in turn with the capture channel, and the handlers
+// added with adc_stream_add_handler() get one round of samples in fast_divide, so they still see the stream
+// rate. They see each sample up to one block later than in the normal stream.
+
+#include <hardware/adc.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include "../hl2ioboard.h"
+
+#define ADC_CLOCK_HZ	48000000	// the ADC clock is 48 MHz and a conversion takes 96 clocks
+#define ADC_MAX_RATE	(ADC_CLOCK_HZ / 96)	// samples per second for all channels
+#define FAST_BLOCK_BITS	7		// each DMA block is 2**7 bytes
+#define FAST_BLOCK	(1 << (FAST_BLOCK_BITS - 1))	// number of samples in a DMA block
+
+volatile uint16_t adc_stream_latest[ADC_STREAM_CHANNELS];
+volatile uint32_t adc_stream_count;		// total number of samples
+volatile uint32_t adc_stream_irq_us;		// time of the last ADC interrupt
+static adc_handler AdcHandler[ADC_STREAM_HANDLERS];
+static uint8_t stream_channels[ADC_STREAM_CHANNELS];	// the channels in conversion order
+static uint8_t stream_nchannels;
+static uint8_t stream_index;		// index into stream_channels of the next sample
+static bool stream_running = false;
+static uint8_t last_mask;		// the channel mask of the last adc_stream_start()
+static uint32_t stream_rate;		// samples per second for each channel
+
+static uint16_t fast_block[2][FAST_BLOCK] __attribute__((aligned(1 << FAST_BLOCK_BITS)));
+static int fast_dma[2] = {-1, -1};	// the DMA channel for each block
+static uint8_t fast_next;		// the block the DMA is writing, or will write next
+static bool fast_running = false;
+static adc_handler fast_handler;	// called for every sample of the fast stream
+static uint8_t fast_channels[ADC_STREAM_CHANNELS];	// the channels in conversion order
+static uint8_t fast_nchannels;
+static uint8_t fast_index;		// index into fast_channels of the next sample
+static uint16_t fast_divide;		// the stream handlers get one round of samples in fast_divide
+static uint16_t fast_round;
+
+static void adc_stream_irq(void)
+{
+	uint16_t sample;
+	uint8_t channel;
+	int i;
+
+	adc_stream_irq_us = time_us_32();
+	if (adc_hw->fcs & ADC_FCS_OVER_BITS) {	// samples were lost, so start again with the first channel
+		adc_run(false);
+		adc_fifo_drain();
+		adc_hw->fcs |= ADC_FCS_OVER_BITS;
+		adc_select_input(stream_channels[0]);
+		stream_index = 0;
+		adc_run(true);
+		return;
+	}
+	while ( ! adc_fifo_is_empty()) {
+		sample = adc_fifo_get();
+		channel = stream_channels[stream_index];
+		if (++stream_index >= stream_nchannels)
+			stream_index = 0;
+		adc_stream_latest[channel] = sample;
+		adc_stream_count++;
+		for (i = 0; i < ADC_STREAM_HANDLERS && AdcHandler[i]; i++)
+			(AdcHandler[i])(channel, sample);
+	}
+}
+
+// Start the stream. Bit n of channel_mask is ADC n; channels 0, 1 and 2 are on GPIO26 to 28, 3 is not connected
+// and 4 is the temperature sensor.
+// The sample_rate is the samples per second for each channel. The total rate can be up to 500,000.
+static void adc_stream_run(void);
+
+void adc_stream_start(uint8_t channel_mask, uint32_t sample_rate)
+{
+	uint8_t channel;
+	uint32_t total_rate;
+
+	adc_stream_stop();
+	last_mask = channel_mask;
+	stream_nchannels = 0;
+	for (channel = 0; channel < ADC_STREAM_CHANNELS; channel++)
+		if (channel_mask & (1 << channel))
+			stream_channels[stream_nchannels++] = channel;
+	if (stream_nchannels == 0)
+		return;
+	total_rate = sample_rate * stream_nchannels;
+	if (total_rate > ADC_MAX_RATE)
+		total_rate = ADC_MAX_RATE;
+	stream_rate = total_rate / stream_nchannels;
+	if (channel_mask & 0x10)
+		adc_set_temp_sensor_enabled(true);
+	stream_running = true;
+	adc_stream_run();
+}
+
+// Start the ADC for the stream set by adc_stream_start().
+static void adc_stream_run(void)
+{
+	adc_select_input(stream_channels[0]);
+	adc_set_round_robin(last_mask);
+	adc_fifo_setup(true, false, 1, false, false);	// FIFO, no DMA, IRQ at one sample, no error bit, 12 bits
+	adc_set_clkdiv((float)ADC_CLOCK_HZ / (stream_rate * stream_nchannels) - 1.0f);
+	stream_index = 0;
+	irq_set_exclusive_handler(ADC_IRQ_FIFO, adc_stream_irq);
+	adc_irq_set_enabled(true);
+	irq_set_enabled(ADC_IRQ_FIFO, true);
+	adc_run(true);
+}
+
+// Stop the ADC, and the IRQ or DMA that reads it.
+static void adc_stream_halt(void)
+{
+	int i;
+
+	adc_run(false);
+	adc_irq_set_enabled(false);
+	irq_set_enabled(ADC_IRQ_FIFO, false);
+	if (fast_running) {
+		irq_set_enabled(DMA_IRQ_0, false);
+		for (i = 0; i < 2; i++) {
+			dma_channel_set_irq0_enabled(fast_dma[i], false);
+			dma_channel_abort(fast_dma[i]);
+			dma_channel_acknowledge_irq0(fast_dma[i]);
+		}
+		fast_running = false;
+	}
+	adc_set_round_robin(0);
+	adc_fifo_setup(false, false, 0, false, false);
+	adc_fifo_drain();
+}
+
+void adc_stream_stop(void)
+{
+	if ( ! stream_running && ! fast_running)
+		return;
+	adc_stream_halt();
+	stream_running = false;
+}
+
+// Return true if the ADC is running for the stream or a capture. Then adc_stream_latest[] is updated, and a
+// conversion must not be started with adc_read().
+bool adc_stream_running(void)
+{
+	return stream_running || fast_running;
+}
+
+// Return the channel mask of the stream, or zero if it is not running.
+uint8_t adc_stream_channels(void)
+{
+	return stream_running ? last_mask : 0;
+}
+
+// Return the samples per second for each channel of the stream.
+uint32_t adc_stream_rate(void)
+{
+	return stream_rate;
+}
+
+// Pass the samples of a finished DMA block to the handlers. This is called from the DMA interrupt.
+static void adc_stream_block(const uint16_t * block)
+{
+	uint16_t sample;
+	uint8_t channel;
+	int i, j;
+
+	for (i = 0; i < FAST_BLOCK; i++) {
+		sample = block[i];
+		channel = fast_channels[fast_index];
+		adc_stream_latest[channel] = sample;
+		adc_stream_count++;
+		(fast_handler)(channel, sample);
+		if (fast_round == 0 && stream_running && (last_mask & (1 << channel)))
+			for (j = 0; j < ADC_STREAM_HANDLERS && AdcHandler[j]; j++)
+				(AdcHandler[j])(channel, sample);
+		if (++fast_index >= fast_nchannels) {
+			fast_index = 0;
+			if (++fast_round >= fast_divide)
+				fast_round = 0;
+		}
+	}
+}
+
+static void adc_stream_dma_irq(void)
+{
+	adc_stream_irq_us = time_us_32();
+	while (dma_channel_get_irq0_status(fast_dma[fast_next])) {	// finished blocks in order
+		dma_channel_acknowledge_irq0(fast_dma[fast_next]);
+		adc_stream_block(fast_block[fast_next]);
+		fast_next ^= 1;
+	}
+}
+
+// Run the ADC with DMA to capture one channel at a high rate. The handler is called from the DMA interrupt
+// for every sample of every channel. If the stream is running, its channels are converted in turn with the
+// capture channel, and its handlers still get the samples at the stream rate. Otherwise only the capture
+// channel is converted. The sample_rate is the samples per second wanted for the capture channel, zero for
+// the highest. Return the actual rate, or zero if the ADC can not run that fast for the stream.
+uint32_t adc_stream_fast_start(uint8_t channel, uint32_t sample_rate, adc_handler handler)
+{
+	dma_channel_config config;
+	uint8_t mask;
+	uint32_t max_rate;
+	int i;
+
+	if (fast_running || channel >= ADC_STREAM_CHANNELS)
+		return 0;
+	mask = (stream_running ? last_mask : 0) | 1 << channel;
+	fast_nchannels = 0;
+	for (i = 0; i < ADC_STREAM_CHANNELS; i++)
+		if (mask & (1 << i))
+			fast_channels[fast_nchannels++] = i;
+	max_rate = ADC_MAX_RATE / fast_nchannels;
+	if (sample_rate == 0 || sample_rate > max_rate)
+		sample_rate = max_rate;
+	if (stream_running) {	// the rate is a multiple of the stream rate
+		if (stream_rate > max_rate)
+			return 0;
+		fast_divide = sample_rate / stream_rate;
+		if (fast_divide == 0)
+			fast_divide = 1;
+		sample_rate = stream_rate * fast_divide;
+	}
+	else {
+		fast_divide = 1;
+	}
+	if (fast_dma[0] < 0) {
+		fast_dma[0] = dma_claim_unused_channel(true);
+		fast_dma[1] = dma_claim_unused_channel(true);
+	}
+	adc_stream_halt();
+	for (i = 0; i < 2; i++) {
+		config = dma_channel_get_default_config(fast_dma[i]);
+		channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+		channel_config_set_read_increment(&config, false);
+		channel_config_set_write_increment(&config, true);
+		channel_config_set_ring(&config, true, FAST_BLOCK_BITS);	// wrap the write address to the block
+		channel_config_set_dreq(&config, DREQ_ADC);
+		channel_config_set_chain_to(&config, fast_dma[i ^ 1]);		// the other channel takes the next block
+		dma_channel_configure(fast_dma[i], &config, fast_block[i], &adc_hw->fifo, FAST_BLOCK, false);
+		dma_channel_set_irq0_enabled(fast_dma[i], true);
+	}
+	fast_handler = handler;
+	fast_next = 0;
+	fast_index = 0;
+	fast_round = 0;
+	fast_running = true;
+	irq_set_exclusive_handler(DMA_IRQ_0, adc_stream_dma_irq);
+	irq_set_enabled(DMA_IRQ_0, true);
+	adc_select_input(fast_channels[0]);
+	adc_set_round_robin(fast_nchannels > 1 ? mask : 0);
+	adc_fifo_setup(true, true, 1, false, false);	// FIFO, DMA, DREQ at one sample, no error bit, 12 bits
+	adc_set_clkdiv((float)ADC_CLOCK_HZ / (sample_rate * fast_nchannels) - 1.0f);
+	dma_channel_start(fast_dma[0]);
+	adc_run(true);
+	return sample_rate;
+}
+
+// Stop the fast ADC, and start the stream again if it was running.
+void adc_stream_fast_stop(void)
+{
+	if ( ! fast_running)
+		return;
+	adc_stream_halt();
+	if (stream_running)
+		adc_stream_run();
+}
+
+// Return the number of samples converted so far, including the samples in a DMA block that the interrupt
+// has not yet passed to the handlers. Call this with interrupts disabled.
+uint32_t adc_stream_position(void)
+{
+	uint32_t position = adc_stream_count;
+	uint8_t block = fast_next;
+
+	if ( ! fast_running)
+		return position;
+	if (dma_channel_get_irq0_status(fast_dma[block])) {	// the block is finished, but not yet passed on
+		position += FAST_BLOCK;
+		block ^= 1;
+	}
+	return position + FAST_BLOCK - dma_hw->ch[fast_dma[block]].transfer_count;
+}
+
+// Add a function to be called from the interrupt for each sample. Return false if there is no room.
+bool adc_stream_add_handler(adc_handler handler)
+{
+	int i;
+
+	for (i = 0; i < ADC_STREAM_HANDLERS; i++) {
+		if (AdcHandler[i] == handler)
+			return true;
+		if (AdcHandler[i] == NULL) {
+			AdcHandler[i] = handler;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,134 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This sends the band to an amplifier with a serial port, such as the Hardrock-50 and Hardrock-500.
+// Call amp_band_start() with the amplifier functions at startup, amp_band_tx() when the Tx frequency code
+// changes, and amp_band_poll() in the polling loop. The band last sent to the amp is in REG_AMP_BAND.
+//
+// Predictive band preselection: if REG_AMP_PRESELECT is 1, follow the Rx frequency in REG_FCODE_RX1 and
+// change the amp band while in receive. Then the band change is usually done before the next key-down,
+// and the Tx frequency change does not need to change bands. The band change time that was removed from
+// the key-down path is added to REG_PRESELECT_SAVED_MSB/LSB in milliseconds. The time is measured from
+// sending the band to the amp's confirmation of the band. If the amp does not confirm the band within
+// AMP_ACK_TIMEOUT_MS, no time is added.
+//
+// The amp may be on the Rx band when transmit starts, because of a split or because RX1 is tuned to
+// another band. So amp_band_poll() sends the Tx band whenever EXTTR is low for Tx and the amp band is not the
+// Tx band. Call it before applying PTT.
+
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+#define PRESELECT_HOLDOFF_MS	300	// wait for the Rx frequency to stop changing
+#define AMP_ACK_TIMEOUT_MS	1000	// wait for the amp to confirm the band
+
+static const struct amp_band_config * amp_config;
+static uint8_t amp_band;			// the band last sent to the amp
+static uint8_t tx_band;				// the band for the Tx frequency
+static bool amp_band_preselected = false;
+static bool ack_waiting = false;		// waiting for the amp to confirm a preselected band
+static uint32_t change_ms;			// the time the preselected band was sent
+static uint32_t preselect_ms;			// the time taken by the last preselect band change
+static uint32_t preselect_saved_ms;		// the total band change time removed from key-down
+
+static uint32_t now_ms(void)
+{
+	return to_ms_since_boot(get_absolute_time());
+}
+
+static void amp_set_band(uint8_t band)
+{
+	amp_config->change_band(band);
+	amp_band = band;
+	Registers[REG_AMP_BAND] = band;
+}
+
+// A reset with REG_CONTROL does not change the amp band, so show it in the registers again.
+static void amp_band_reset(void)
+{
+	if (amp_band != amp_config->band_unknown)
+		Registers[REG_AMP_BAND] = amp_band;
+	Registers[REG_PRESELECT_SAVED_MSB] = preselect_saved_ms >> 8;
+	Registers[REG_PRESELECT_SAVED_LSB] = preselect_saved_ms & 0xFF;
+}
+
+void amp_band_start(const struct amp_band_config * config)
+{
+	amp_config = config;
+	amp_band = tx_band = config->band_unknown;
+	register_add_reset_handler(amp_band_reset);
+}
+
+// Call this when the Tx frequency code changes.
+void amp_band_tx(uint8_t band)
+{
+	tx_band = band;
+	if (amp_band_preselected && band == amp_band) {
+		// The band was already changed during receive
+		if ( ! ack_waiting) {
+			preselect_saved_ms += preselect_ms;
+			if (preselect_saved_ms > 0xFFFF)
+				preselect_saved_ms = 0xFFFF;
+			Registers[REG_PRESELECT_SAVED_MSB] = preselect_saved_ms >> 8;
+			Registers[REG_PRESELECT_SAVED_LSB] = preselect_saved_ms & 0xFF;
+		}
+	} else {
+		amp_set_band(band);
+	}
+	amp_band_preselected = false;
+	ack_waiting = false;
+}
+
+// Call this in the polling loop.
+void amp_band_poll(void)
+{
+	static uint8_t rx_fcode = 0;
+	static uint32_t rx_fcode_ms;
+	uint32_t time0;
+	uint8_t band;
+
+	if ( ! gpio_get(GPIO13_EXTTR)) {	// EXTTR is low for Tx
+		if (amp_band != tx_band) {
+			amp_set_band(tx_band);
+			amp_band_preselected = false;
+			ack_waiting = false;
+		}
+		return;
+	}
+	if (ack_waiting) {
+		if (amp_config->band_ack(amp_band)) {
+			preselect_ms = now_ms() - change_ms;
+			ack_waiting = false;
+		}
+		else if (now_ms() - change_ms >= AMP_ACK_TIMEOUT_MS) {
+			preselect_ms = 0;	// the time is not known
+			ack_waiting = false;
+		}
+		return;
+	}
+	if (Registers[REG_AMP_PRESELECT] != 1)
+		return;
+	if (rx_fcode != Registers[REG_FCODE_RX1]) {
+		rx_fcode = Registers[REG_FCODE_RX1];
+		rx_fcode_ms = now_ms();
+		return;
+	}
+	if (rx_fcode == 0 || ! amp_config->serial_idle())
+		return;
+	if (now_ms() - rx_fcode_ms < PRESELECT_HOLDOFF_MS)
+		return;
+	band = amp_config->fcode2band(rx_fcode);
+	if (band == amp_band || band == amp_config->band_unknown)
+		return;
+	time0 = now_ms();
+	amp_set_band(band);
+	amp_band_preselected = true;
+	if (amp_config->band_ack) {		// wait for the confirmation in later polls
+		change_ms = time0;
+		ack_waiting = true;
+	}
+	else {				// change_band() waited for the confirmation
+		preselect_ms = now_ms() - time0;
+	}
+}
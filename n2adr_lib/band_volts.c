@@ -0,0 +1,200 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This is a high resolution band voltage output on J4 pin 8. The PWM carrier is 125 MHz / 256 = 488 kHz,
+// four times the frequency of the plain PWM, so the RC filter ripple is less and a faster filter can be used.
+// The PWM level has only 8 bits, so it is dithered with a first order sigma-delta pattern of 64 levels for
+// 14 bits of resolution. DMA copies the pattern to the PWM compare register at each PWM wrap, so the dither
+// uses no CPU time. A second DMA channel restarts the first when its count runs out.
+//
+// The output is calibrated by points of the output code and the measured millivolts. To add a point, set a
+// voltage, measure it at J4 pin 8, write the measured millivolts to REG_BAND_VOLTS_MEASURED_MSB/LSB and then
+// write 1 to REG_BAND_VOLTS_CAL. Write 2 to clear the calibration. The points are saved in the flash store.
+// Call band_volts_start() after configure_pins() with use_pwm4a and after flash_store_init(), and call
+// band_volts_poll() in the polling loop. J4Pin8_millivolts() then uses this output.
+
+#include <string.h>
+#include <hardware/dma.h>
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+#define BV_WRAP			255	// 8-bit PWM
+#define BV_DITHER_BITS		6
+#define BV_DITHER		(1 << BV_DITHER_BITS)	// length of the dither pattern
+#define BV_CODE_MAX		((BV_WRAP + 1) << BV_DITHER_BITS)	// full scale code
+#define BV_FULL_SCALE_MV	5000	// full scale output without calibration
+#define BV_CAL_POINTS		8
+
+struct bv_cal_point {
+	uint16_t code;
+	uint16_t millivolts;
+};
+
+static uint32_t dither[BV_DITHER] __attribute__((aligned(BV_DITHER * 4)));
+static uint32_t dither_address;		// the control DMA channel copies this to the data channel
+static int data_dma = -1, ctrl_dma;
+static struct bv_cal_point BvCal[BV_CAL_POINTS];	// in increasing order of code
+static uint8_t bv_cal_count;
+static uint16_t bv_code, bv_millivolts;
+
+// Return the output code for these millivolts using the calibration points.
+static uint16_t band_volts_code(uint16_t millivolts)
+{
+	const struct bv_cal_point * p0, * p1;
+	int32_t code;
+	int i;
+
+	if (bv_cal_count == 0) {
+		code = (int32_t)millivolts * BV_CODE_MAX / BV_FULL_SCALE_MV;
+	}
+	else if (bv_cal_count == 1) {	// one point sets the gain
+		p0 = BvCal;
+		code = p0->millivolts ? (int32_t)millivolts * p0->code / p0->millivolts : 0;
+	}
+	else {		// interpolate between points, or extrapolate from the end points
+		for (i = 1; i < bv_cal_count - 1; i++)
+			if (millivolts < BvCal[i].millivolts)
+				break;
+		p0 = BvCal + i - 1;
+		p1 = BvCal + i;
+		if (p1->millivolts == p0->millivolts)
+			code = p0->code;
+		else
+			code = p0->code + ((int32_t)millivolts - p0->millivolts) * ((int32_t)p1->code - p0->code) /
+				((int32_t)p1->millivolts - p0->millivolts);
+	}
+	if (code < 0)
+		return 0;
+	return code > BV_CODE_MAX ? BV_CODE_MAX : code;
+}
+
+// Fill the dither pattern for this code. The average PWM level is code / BV_DITHER.
+static void band_volts_code_out(uint16_t code)
+{
+	uint32_t coarse, fraction, sum;
+	int i;
+
+	bv_code = code;
+	coarse = code >> BV_DITHER_BITS;
+	fraction = code & (BV_DITHER - 1);
+	sum = 0;
+	for (i = 0; i < BV_DITHER; i++) {
+		sum += fraction;
+		if (sum >= BV_DITHER) {
+			sum -= BV_DITHER;
+			dither[i] = coarse + 1;
+		}
+		else {
+			dither[i] = coarse;
+		}
+	}
+	Registers[REG_BAND_VOLTS_CODE_MSB] = code >> 8;
+	Registers[REG_BAND_VOLTS_CODE_LSB] = code & 0xFF;
+}
+
+// Set the output in millivolts. This may be called from the I2C handler.
+void band_volts_set(uint16_t millivolts)
+{
+	bv_millivolts = millivolts;
+	band_volts_code_out(band_volts_code(millivolts));
+	Registers[REG_BAND_VOLTS_MSB] = millivolts >> 8;
+	Registers[REG_BAND_VOLTS_LSB] = millivolts & 0xFF;
+	millivolts = millivolts > 5000 ? 5000 : millivolts;
+	Registers[GPIO_DIRECT_BASE + GPIO08_Out8] = ((uint32_t)millivolts * 255 + 2500) / 5000;
+}
+
+bool band_volts_running(void)
+{
+	return data_dma >= 0;
+}
+
+// Write the low byte of the millivolts to set the output.
+static void band_volts_write(uint8_t reg, uint8_t data)
+{
+	band_volts_set(Registers[REG_BAND_VOLTS_MSB] << 8 | data);
+}
+
+static void band_volts_save(void)
+{
+	flash_store_write(FLASH_KEY_BAND_VOLTS_CAL, BvCal, bv_cal_count * sizeof(struct bv_cal_point));
+}
+
+// Add a calibration point for the current code, replacing any point with the same code.
+static void band_volts_add_point(uint16_t millivolts)
+{
+	int i, j;
+
+	for (i = 0; i < bv_cal_count; i++)
+		if (BvCal[i].code >= bv_code)
+			break;
+	if (i >= bv_cal_count || BvCal[i].code != bv_code) {
+		if (bv_cal_count >= BV_CAL_POINTS)
+			return;
+		for (j = bv_cal_count; j > i; j--)
+			BvCal[j] = BvCal[j - 1];
+		bv_cal_count++;
+	}
+	BvCal[i].code = bv_code;
+	BvCal[i].millivolts = millivolts;
+}
+
+// A reset with REG_CONTROL does not change the output, so show it in the registers again.
+static void band_volts_reset(void)
+{
+	band_volts_set(bv_millivolts);
+}
+
+// Start the PWM and the dither DMA. The calibration is read from the flash store.
+void band_volts_start(void)
+{
+	dma_channel_config config;
+	int length;
+
+	length = flash_store_read(FLASH_KEY_BAND_VOLTS_CAL, BvCal, sizeof(BvCal));
+	bv_cal_count = length > 0 ? length / sizeof(struct bv_cal_point) : 0;
+	gpio_set_function(GPIO08_Out8, GPIO_FUNC_PWM);
+	pwm_set_clkdiv(FT817_SLICE, 1.0f);
+	pwm_set_wrap(FT817_SLICE, BV_WRAP);
+	band_volts_code_out(0);
+	pwm_set_chan_level(FT817_SLICE, FT817_CHAN, 0);
+	pwm_set_enabled(FT817_SLICE, true);
+
+	data_dma = dma_claim_unused_channel(true);
+	ctrl_dma = dma_claim_unused_channel(true);
+	dither_address = (uint32_t)dither;
+	// The data channel copies the pattern to the compare register, channel A is the low 16 bits
+	config = dma_channel_get_default_config(data_dma);
+	channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+	channel_config_set_read_increment(&config, true);
+	channel_config_set_write_increment(&config, false);
+	channel_config_set_ring(&config, false, BV_DITHER_BITS + 2);	// wrap the read address
+	channel_config_set_dreq(&config, DREQ_PWM_WRAP0 + FT817_SLICE);
+	channel_config_set_chain_to(&config, ctrl_dma);
+	dma_channel_configure(data_dma, &config, &pwm_hw->slice[FT817_SLICE].cc, dither, 0xFFFFFFFF, false);
+	// The control channel restarts the data channel
+	config = dma_channel_get_default_config(ctrl_dma);
+	channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+	channel_config_set_read_increment(&config, false);
+	channel_config_set_write_increment(&config, false);
+	dma_channel_configure(ctrl_dma, &config, &dma_hw->ch[data_dma].al3_read_addr_trig, &dither_address, 1, false);
+	dma_channel_start(data_dma);
+	IrqHandler[REG_BAND_VOLTS_LSB] = band_volts_write;
+	register_add_reset_handler(band_volts_reset);
+}
+
+// Call this in the polling loop to perform calibration requests.
+void band_volts_poll(void)
+{
+	uint8_t command = Registers[REG_BAND_VOLTS_CAL];
+
+	if (command == 0 || ! band_volts_running())
+		return;
+	if (command == 1)
+		band_volts_add_point(Registers[REG_BAND_VOLTS_MEASURED_MSB] << 8 | Registers[REG_BAND_VOLTS_MEASURED_LSB]);
+	else if (command == 2)
+		bv_cal_count = 0;
+	band_volts_save();
+	band_volts_set(bv_millivolts);
+	Registers[REG_BAND_VOLTS_CAL] = 0;
+}
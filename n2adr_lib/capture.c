@@ -0,0 +1,217 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This captures one ADC channel at up to 500,000 samples per second into a RAM buffer, triggered by the
+// start of transmit. Write 1 to REG_CAPTURE_CONTROL to arm the capture. The ADC stream then runs with DMA
+// at the capture rate, see adc_stream_fast_start(), and a handler writes each sample of the channel into a
+// ring buffer. When EXTTR goes low for transmit, the capture continues for the samples after the trigger and
+// stops, so the buffer holds REG_CAPTURE_PRETRIGGER times 16 samples before the trigger. Then the ADC stream
+// returns to its normal rate, REG_CAPTURE_CONTROL is 3 and the summary registers hold the peak sample and its
+// time, the PEP of the envelope and the overshoot of the envelope peak over the final level. The buffer is
+// rotated so the oldest sample is first, and it is read as register bank BANK_CAPTURE with samples least
+// significant byte first.
+//
+// The channels of the ADC stream are converted in turn with the capture channel, so the protection engine
+// and the other stream handlers keep running at the stream rate. The capture rate is the rate written to
+// REG_CAPTURE_RATE_MSB/LSB, or the highest the ADC can do for all the channels, rounded down to a multiple
+// of the stream rate. It is 500,000 if the stream is not running, and 160,000 for a stream of three channels
+// at 10,000. The actual rate is in REG_CAPTURE_RATE_MSB/LSB after the capture is armed. If the ADC can not
+// convert the stream channels and the capture channel at the stream rate, the capture is not armed and
+// REG_CAPTURE_CONTROL returns to zero. Call capture_init() at startup and capture_poll() in the polling loop.
+
+#include <string.h>
+#include <hardware/sync.h>
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+#define CAPTURE_SIZE		4080	// number of samples, 255 bank pages of 16 samples
+#define CAPTURE_ENVELOPE	16	// number of samples in the envelope average
+#define CAPTURE_PRETRIGGER_DEFAULT	64	// default pre-trigger in units of 16 samples
+
+#define CAPTURE_IDLE		0
+#define CAPTURE_ARMED		1
+#define CAPTURE_RUNNING		2
+#define CAPTURE_DONE		3
+#define CAPTURE_FILLED		4	// the buffer is full, and capture_poll() will analyze it
+#define CAPTURE_TRIGGERED	5	// EXTTR went low, and the handler has not reached the trigger sample
+
+static uint16_t capture_buffer[CAPTURE_SIZE];
+static volatile uint8_t capture_state = CAPTURE_IDLE;
+static uint8_t capture_channel;
+static uint32_t capture_rate;		// samples per second
+static uint16_t pretrigger;		// number of samples before the trigger
+static uint16_t start_index;		// buffer index of the oldest sample
+static uint16_t write_index;		// buffer index of the next sample
+static uint16_t remaining;		// number of samples to write after the trigger
+static uint32_t trigger_position;	// the ADC stream position of the trigger
+
+// This is called from the DMA interrupt for each sample.
+static void capture_adc_handler(uint8_t channel, uint16_t sample)
+{
+	if (channel != capture_channel)
+		return;
+	switch (capture_state) {
+	case CAPTURE_TRIGGERED:		// adc_stream_count - 1 is the position of this sample
+		if ((int32_t)(adc_stream_count - 1 - trigger_position) < 0)
+			break;
+		start_index = (write_index + CAPTURE_SIZE - pretrigger) % CAPTURE_SIZE;
+		remaining = CAPTURE_SIZE - pretrigger;
+		capture_state = CAPTURE_RUNNING;
+		break;
+	case CAPTURE_ARMED:
+	case CAPTURE_RUNNING:
+		break;
+	default:
+		return;
+	}
+	capture_buffer[write_index] = sample;
+	if (++write_index >= CAPTURE_SIZE)
+		write_index = 0;
+	if (capture_state == CAPTURE_RUNNING && --remaining == 0)
+		capture_state = CAPTURE_FILLED;
+}
+
+void capture_init(void)
+{
+	bank_register(BANK_CAPTURE, capture_buffer, sizeof(capture_buffer), false);
+}
+
+static void capture_arm(void)
+{
+	uint8_t channel;
+	uint32_t rate;
+
+	channel = Registers[REG_CAPTURE_CHANNEL] <= 2 ? Registers[REG_CAPTURE_CHANNEL] : 0;
+	rate = (Registers[REG_CAPTURE_RATE_MSB] << 8 | Registers[REG_CAPTURE_RATE_LSB]) * 10;
+	pretrigger = Registers[REG_CAPTURE_PRETRIGGER] ? Registers[REG_CAPTURE_PRETRIGGER] : CAPTURE_PRETRIGGER_DEFAULT;
+	pretrigger *= 16;
+	if (pretrigger >= CAPTURE_SIZE)
+		pretrigger = CAPTURE_SIZE - 16;
+	memset(capture_buffer, 0, sizeof(capture_buffer));
+	capture_channel = channel;
+	write_index = 0;
+	capture_state = CAPTURE_ARMED;
+	capture_rate = adc_stream_fast_start(channel, rate, capture_adc_handler);
+	if (capture_rate == 0) {	// the ADC can not run the stream and the capture
+		capture_state = CAPTURE_IDLE;
+		Registers[REG_CAPTURE_CONTROL] = CAPTURE_IDLE;
+		return;
+	}
+	rate = capture_rate / 10;
+	Registers[REG_CAPTURE_RATE_MSB] = rate >> 8;
+	Registers[REG_CAPTURE_RATE_LSB] = rate & 0xFF;
+}
+
+// This is called from the GPIO interrupt when EXTTR goes low for transmit. Record the ADC stream position,
+// and the handler starts counting the samples following the trigger from there.
+void capture_trigger(void)
+{
+	uint32_t status;
+
+	if (capture_state != CAPTURE_ARMED)
+		return;
+	status = save_and_disable_interrupts();		// the DMA interrupt must not add a sample here
+	trigger_position = adc_stream_position();
+	capture_state = CAPTURE_TRIGGERED;
+	restore_interrupts(status);
+}
+
+static void capture_reverse(int first, int last)
+{
+	uint16_t sample;
+
+	for ( ; first < last; first++, last--) {
+		sample = capture_buffer[first];
+		capture_buffer[first] = capture_buffer[last];
+		capture_buffer[last] = sample;
+	}
+}
+
+// Rotate the buffer so the oldest sample is at index zero.
+static void capture_rotate(void)
+{
+	if (start_index == 0)
+		return;
+	capture_reverse(0, start_index - 1);
+	capture_reverse(start_index, CAPTURE_SIZE - 1);
+	capture_reverse(0, CAPTURE_SIZE - 1);
+	start_index = 0;
+}
+
+// Calculate the summary registers from the samples.
+static void capture_analyze(void)
+{
+	uint32_t sum, envelope, env_peak, settled, overshoot;
+	uint16_t sample, peak;
+	int i, peak_index;
+	int64_t peak_us;
+
+	sum = env_peak = settled = 0;
+	peak = 0;
+	peak_index = 0;
+	for (i = 0; i < CAPTURE_SIZE; i++) {
+		sample = capture_buffer[(start_index + i) % CAPTURE_SIZE];
+		if (sample > peak) {
+			peak = sample;
+			peak_index = i;
+		}
+		// The envelope is the average of the last CAPTURE_ENVELOPE samples
+		sum += sample;
+		if (i >= CAPTURE_ENVELOPE)
+			sum -= capture_buffer[(start_index + i - CAPTURE_ENVELOPE) % CAPTURE_SIZE];
+		envelope = sum / CAPTURE_ENVELOPE;
+		if (i >= CAPTURE_ENVELOPE - 1 && envelope > env_peak)
+			env_peak = envelope;
+		if (i >= CAPTURE_SIZE * 3 / 4)	// the final level is the average of the last quarter
+			settled += sample;
+	}
+	settled /= CAPTURE_SIZE / 4;
+	peak_us = ((int64_t)peak_index - pretrigger) * 1000000 / capture_rate;
+	if (peak_us > 32767)
+		peak_us = 32767;
+	else if (peak_us < -32768)
+		peak_us = -32768;
+	if (settled == 0 || env_peak <= settled)
+		overshoot = 0;
+	else
+		overshoot = (env_peak - settled) * 100 / settled;
+	if (overshoot > 255)
+		overshoot = 255;
+	envelope = meter_power(true, env_peak);
+	Registers[REG_CAPTURE_PEAK_MSB] = peak >> 8;
+	Registers[REG_CAPTURE_PEAK_LSB] = peak & 0xFF;
+	Registers[REG_CAPTURE_PEAK_TIME_MSB] = (uint16_t)peak_us >> 8;
+	Registers[REG_CAPTURE_PEAK_TIME_LSB] = (uint16_t)peak_us & 0xFF;
+	Registers[REG_CAPTURE_PEP_MSB] = envelope >> 8;
+	Registers[REG_CAPTURE_PEP_LSB] = envelope & 0xFF;
+	Registers[REG_CAPTURE_OVERSHOOT] = overshoot;
+}
+
+// Call this in the polling loop.
+void capture_poll(void)
+{
+	switch (capture_state) {
+	case CAPTURE_IDLE:
+	case CAPTURE_DONE:
+		if (Registers[REG_CAPTURE_CONTROL] == 1)	// arm
+			capture_arm();
+		break;
+	case CAPTURE_ARMED:
+	case CAPTURE_TRIGGERED:
+	case CAPTURE_RUNNING:
+	case CAPTURE_FILLED:
+		if (Registers[REG_CAPTURE_CONTROL] == 0) {	// cancel
+			adc_stream_fast_stop();
+			capture_state = CAPTURE_IDLE;
+		}
+		else if (capture_state == CAPTURE_FILLED) {
+			adc_stream_fast_stop();
+			capture_analyze();
+			capture_rotate();
+			capture_state = CAPTURE_DONE;
+			Registers[REG_CAPTURE_CONTROL] = CAPTURE_DONE;
+		}
+		break;
+	}
+}
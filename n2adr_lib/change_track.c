@@ -0,0 +1,97 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This tells the host which registers changed so it only needs to read those. The registers are divided into
+// sixteen blocks of sixteen registers, and bit n of the dirty bitmap is set when a register in block n changes.
+// A read of REG_CHANGE_SEQ_MSB copies the counter and the bitmap to REG_CHANGE_SEQ_MSB to REG_DIRTY_LSB and
+// clears the bitmap, so one four byte read returns all of it. The counter is incremented by each read that
+// takes a bitmap that is not zero. So a host whose counter went up by one has all the changes since its last
+// read, and a host whose counter went up by more knows that another host took some of the bits. The counter
+// starts at one and skips zero, so a host that reads zero knows the firmware does not support this.
+//
+// Call change_track_start() at startup and change_track_poll() in the polling loop. The poll compares the registers
+// to a copy, and also checks the GPIO pins and the ADC samples that the I2C handler returns for reads. Registers
+// that the I2C handler sets for a read, such as the ADC and meter registers, are changed by the read, so a host
+// that reads them will usually see them as changed. The LED is not checked, because it flashes for each I2C transfer.
+
+#include <string.h>
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+#define CHANGE_BLOCK(reg)	(1 << ((reg) / 16))
+#define CHANGE_ADC_SHIFT	4	// ignore ADC changes in the low four bits
+#define CHANGE_GPIO_MASK	(~(1u << GPIO25_LED))
+
+static uint8_t RegisterCopy[256];	// a copy of Registers
+static uint32_t gpio_copy;
+static uint8_t adc_copy[3];
+static uint16_t change_seq = 1;
+static volatile uint16_t change_dirty;
+static uint16_t change_telemetry;	// changed blocks for the telemetry stream
+
+// Copy the counter and the bitmap to the registers and clear the bitmap. This is called from the I2C handler.
+void change_track_registers(void)
+{
+	if (change_dirty && ++change_seq == 0)
+		change_seq = 1;
+	Registers[REG_CHANGE_SEQ_MSB] = change_seq >> 8;
+	Registers[REG_CHANGE_SEQ_LSB] = change_seq & 0xFF;
+	Registers[REG_DIRTY_MSB] = change_dirty >> 8;
+	Registers[REG_DIRTY_LSB] = change_dirty & 0xFF;
+	change_dirty = 0;
+}
+
+void change_track_start(void)
+{
+	memcpy(RegisterCopy, Registers, sizeof(RegisterCopy));
+	gpio_copy = gpio_get_all() & CHANGE_GPIO_MASK;
+	change_dirty = change_telemetry = 0xFFFF;
+}
+
+// Call this in the polling loop.
+void change_track_poll(void)
+{
+	uint32_t gpio;
+	uint16_t dirty = 0;
+	uint8_t adc;
+	int i;
+
+	// The change registers themselves are not a change
+	memcpy(RegisterCopy + REG_CHANGE_SEQ_MSB, Registers + REG_CHANGE_SEQ_MSB, 4);
+	for (i = 0; i < 256; i += 16) {
+		if (memcmp(Registers + i, RegisterCopy + i, 16)) {
+			memcpy(RegisterCopy + i, Registers + i, 16);
+			dirty |= CHANGE_BLOCK(i);
+		}
+	}
+	// The I2C handler reads the pins and the ADC for these registers, so they are not in Registers[]
+	gpio = gpio_get_all() & CHANGE_GPIO_MASK;
+	if (gpio != gpio_copy) {
+		gpio_copy = gpio;
+		dirty |= CHANGE_BLOCK(REG_INPUT_PINS) | CHANGE_BLOCK(REG_STATUS);
+		dirty |= CHANGE_BLOCK(GPIO_DIRECT_BASE) | CHANGE_BLOCK(GPIO_DIRECT_BASE + 16) | CHANGE_BLOCK(GPIO_DIRECT_BASE + 28);
+	}
+	if (adc_stream_running()) {
+		for (i = 0; i < 3; i++) {
+			adc = adc_stream_latest[i] >> CHANGE_ADC_SHIFT;
+			if (adc != adc_copy[i]) {
+				adc_copy[i] = adc;
+				dirty |= CHANGE_BLOCK(REG_ADC0_MSB);
+			}
+		}
+	}
+	if (dirty) {
+		change_dirty |= dirty;
+		change_telemetry |= dirty;
+	}
+}
+
+// Return the blocks that changed since the last call, and clear them. This is used by the telemetry stream.
+uint16_t change_track_take(void)
+{
+	uint16_t dirty = change_telemetry;
+
+	change_telemetry = 0;
+	return dirty;
+}
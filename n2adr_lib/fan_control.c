@@ -0,0 +1,163 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This is a fan controller for the fan PWM on GPIO04_Fan. It runs from a repeating timer every FAN_TICK_MS.
+// If the mode in the low bits of REG_FAN_CONTROL is zero, the fan is controlled by REG_FAN_SPEED as before.
+// Otherwise the temperature is read from the RP2040 temperature sensor (mode 1) or from a sensor on ADC0 to
+// ADC2 (modes 2 to 4) with 10 millivolts per degree C and zero volts at zero degrees, such as the LM35.
+// The fan starts when the temperature reaches REG_FAN_SETPOINT and stops when it falls REG_FAN_HYSTERESIS
+// degrees below it. While it runs, a PI controller sets the duty cycle between REG_FAN_MIN and 255 with a
+// proportional gain of REG_FAN_GAIN duty steps per degree C. The fan is run at full speed for a short time when
+// it starts so that it spins up. The duty cycle is copied to REG_FAN_SPEED.
+//
+// If bit 4 of REG_FAN_CONTROL is set, the fan tach pulses on In4 (GPIO07) are counted by the PWM slice 3 counter
+// and the RPM is in REG_FAN_RPM_MSB/LSB. If the fan is driven but there are no pulses, bit 7 of REG_FAN_CONTROL
+// is set for a stall. If the ADC stream is running, the temperature channel must be one of its channels.
+
+#include <hardware/adc.h>
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+#define FAN_TICK_MS		100	// controller period
+#define FAN_TACH_TICKS		10	// count the tach pulses for this many ticks
+#define FAN_PULSES_PER_REV	2	// most PC fans give two tach pulses per revolution
+#define FAN_KICK_TICKS		5	// run at full speed for this many ticks when starting
+#define FAN_STALL_TICKS		30	// time to wait for tach pulses before a stall
+#define FAN_TACH_SLICE		3	// In4 is GPIO07, PWM slice 3 channel B
+
+static struct repeating_timer fan_timer;
+static int32_t temp_x10 = -1000;		// filtered temperature times 10
+static int32_t integral;			// PI integral in duty steps times 100
+static int32_t integral_rem;			// remainder of the integral step, so small errors still add up
+static bool fan_on, tach_on;
+static uint8_t kick_ticks, tach_ticks;
+static uint16_t stall_ticks;
+
+// Return the temperature in degrees C times 10, or -1000 if it can not be read.
+static int32_t fan_read_temp(uint8_t channel)
+{
+	uint16_t raw;
+
+	if (adc_stream_running()) {
+		if ( ! (adc_stream_channels() & (1 << channel)))
+			return -1000;
+		raw = adc_stream_latest[channel];
+	}
+	else {
+		adc_select_input(channel);
+		raw = adc_read();
+	}
+	if (channel == 4)	// the sensor is 0.706 volts at 27 C and falls 1.721 mV per degree C
+		return 270 - ((int32_t)raw * 30000 / 4096 - 7060) * 1000 / 1721;
+	return (int32_t)raw * 3000 / 4096;	// 10 mV per degree C with the 3.00 volt ADC reference
+}
+
+static void fan_tach(bool enable)
+{
+	pwm_config config;
+
+	if (enable == tach_on)
+		return;
+	tach_on = enable;
+	if (enable) {
+		gpio_set_function(GPIO07_In4, GPIO_FUNC_PWM);
+		config = pwm_get_default_config();
+		pwm_config_set_clkdiv_mode(&config, PWM_DIV_B_RISING);
+		pwm_init(FAN_TACH_SLICE, &config, true);
+		tach_ticks = 0;
+	}
+	else {
+		pwm_set_enabled(FAN_TACH_SLICE, false);
+		gpio_init(GPIO07_In4);
+		gpio_set_dir(GPIO07_In4, GPIO_IN);
+		Registers[REG_FAN_RPM_MSB] = 0;
+		Registers[REG_FAN_RPM_LSB] = 0;
+	}
+}
+
+static void fan_set_duty(uint8_t duty)
+{
+	pwm_set_chan_level(FAN_SLICE, FAN_CHAN, (uint16_t)duty * 4);
+	Registers[REG_FAN_SPEED] = duty;
+}
+
+static bool fan_timer_callback(struct repeating_timer * timer)
+{
+	uint8_t control = Registers[REG_FAN_CONTROL];
+	uint8_t mode = control & 0x07;
+	int32_t temp, error, duty, step;
+	uint32_t rpm;
+
+	fan_tach(control & 0x10);
+	if (tach_on && ++tach_ticks >= FAN_TACH_TICKS) {
+		rpm = (uint32_t)pwm_get_counter(FAN_TACH_SLICE) * 60000 / (FAN_TICK_MS * FAN_TACH_TICKS * FAN_PULSES_PER_REV);
+		pwm_set_counter(FAN_TACH_SLICE, 0);
+		tach_ticks = 0;
+		if (rpm > 0xFFFF)
+			rpm = 0xFFFF;
+		Registers[REG_FAN_RPM_MSB] = rpm >> 8;
+		Registers[REG_FAN_RPM_LSB] = rpm & 0xFF;
+		// A stall is a driven fan with no tach pulses
+		if (rpm == 0 && Registers[REG_FAN_SPEED] && stall_ticks >= FAN_STALL_TICKS)
+			Registers[REG_FAN_CONTROL] = control | 0x80;
+		else if (rpm)
+			Registers[REG_FAN_CONTROL] = control & ~0x80;
+	}
+	if (Registers[REG_FAN_SPEED] && stall_ticks < 0xFFFF)
+		stall_ticks++;
+	else if ( ! Registers[REG_FAN_SPEED])
+		stall_ticks = 0;
+	if (mode == 0 || mode > 4) {	// manual control with REG_FAN_SPEED
+		fan_on = false;
+		integral = integral_rem = 0;
+		return true;
+	}
+	temp = fan_read_temp(mode == 1 ? 4 : mode - 2);
+	if (temp <= -1000)
+		return true;
+	if (temp_x10 <= -1000)
+		temp_x10 = temp;
+	else
+		temp_x10 += (temp - temp_x10) / 4;
+	Registers[REG_FAN_TEMP] = temp_x10 < 0 ? 0 : temp_x10 > 2550 ? 255 : (temp_x10 + 5) / 10;
+	error = temp_x10 - (int32_t)Registers[REG_FAN_SETPOINT] * 10;
+	if (fan_on && error <= -(int32_t)Registers[REG_FAN_HYSTERESIS] * 10) {
+		fan_on = false;
+		integral = integral_rem = 0;
+	}
+	else if ( ! fan_on && error >= 0) {
+		fan_on = true;
+		kick_ticks = FAN_KICK_TICKS;
+		stall_ticks = 0;
+	}
+	if ( ! fan_on) {
+		fan_set_duty(0);
+		return true;
+	}
+	// The integral gain is the proportional gain divided by 8 per second
+	step = (int32_t)Registers[REG_FAN_GAIN] * error * FAN_TICK_MS + integral_rem;
+	integral += step / 8000;
+	integral_rem = step % 8000;
+	if (integral < 0)
+		integral = integral_rem = 0;
+	else if (integral > 25500)
+		integral = 25500;
+	duty = Registers[REG_FAN_MIN] + (int32_t)Registers[REG_FAN_GAIN] * error / 10 + integral / 100;
+	if (duty < Registers[REG_FAN_MIN])
+		duty = Registers[REG_FAN_MIN];
+	if (duty > 255 || kick_ticks) {
+		duty = 255;
+		if (kick_ticks)
+			kick_ticks--;
+	}
+	fan_set_duty(duty);
+	return true;
+}
+
+// Start the fan controller timer. The temperature sensor is enabled for mode 1.
+void fan_control_start(void)
+{
+	adc_set_temp_sensor_enabled(true);
+	add_repeating_timer_ms(FAN_TICK_MS, fan_timer_callback, NULL, &fan_timer);
+}
@@ -0,0 +1,342 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This is a small key/value store in the spare flash at the end of the Pico flash. It is used to keep
+// settings, calibration and caches across a power cycle.
+//
+// The store uses FLASH_STORE_SECTORS sectors of 4096 bytes. One sector is active at a time. Each write
+// appends a record to the active sector, so the last record for a key is the current value. When the
+// sector is full, the current records are copied to the next sector and the old sector is abandoned.
+// The sectors are used in turn to spread the erase cycles. A record is a key, a length, a CRC and the
+// data, and records with a bad CRC are ignored. A RAM index holds the offset of the current record for
+// each key, so reads come from the memory mapped flash without a search.
+//
+// The flash can not be read while it is programmed or erased, and the program runs from flash.
+// So the flash is only changed with interrupts disabled, and only when the I2C bus has been quiet
+// and the HL2 is in receive. Writes are staged in RAM by flash_store_write() and written later by
+// flash_store_poll(), which you must call in the polling loop in main(). Each poll does one flash
+// operation: one record of at most two pages, one sector erase, or one record copied by a compaction.
+// Interrupts, including the I2C slave interrupt, are disabled for each page program and erase. A page program
+// takes about 0.4 ms and at most 3 ms. A sector erase takes about 45 ms and at most 400 ms for the
+// flash on the Pico. Core 1 must not run code from flash.
+//
+// To keep the long erase off the I2C bus, flash_store_init() erases the sectors that are not active before
+// the I2C bus starts, and a compaction into an erased sector needs no erase. So a sector is only erased
+// while the firmware runs after FLASH_STORE_SECTORS - 1 compactions since the power was turned on, and
+// then only after the I2C bus was quiet for FLASH_STORE_ERASE_QUIET_MS. During that erase the I2C
+// hardware still accepts a write of up to 16 bytes into its FIFO, and holds SCL low for a read until
+// the interrupt runs, for at most 400 ms.
+
+#include <string.h>
+#include <hardware/flash.h>
+#include <hardware/sync.h>
+#include "../hl2ioboard.h"
+
+#define FLASH_STORE_SECTORS	4
+#define FLASH_STORE_OFFSET	(PICO_FLASH_SIZE_BYTES - FLASH_STORE_SECTORS * FLASH_SECTOR_SIZE)
+#define FLASH_STORE_MAGIC	0x32484C53	// "SLH2"
+#define FLASH_STORE_PENDING	8		// number of staged writes
+#define FLASH_STORE_QUIET_MS	20		// I2C quiet time before a page program
+#define FLASH_STORE_ERASE_QUIET_MS	50	// I2C quiet time before a sector erase, less than a 100 ms poll
+
+struct flash_sector_header {
+	uint32_t magic;
+	uint32_t generation;		// the sector with the highest generation is active
+};
+
+struct flash_record_header {
+	uint8_t key;			// 0xFF is erased flash and is not a valid key
+	uint8_t length;			// data length; zero deletes the key
+	uint16_t crc;			// CRC of the key, length and data
+};
+
+#define HEADER_SIZE	sizeof(struct flash_sector_header)
+#define RECORD_SIZE(length)	((sizeof(struct flash_record_header) + (length) + 3) & ~3)
+
+static int active_sector = -1;		// -1 if there is no valid sector
+static uint32_t active_generation;
+static uint32_t write_offset;		// offset of the next record in the active sector
+static uint16_t record_index[256];	// offset of the current record for each key, or zero
+static int compact_sector = -1;		// the sector being filled by a compaction, or -1
+static int compact_key;			// the next key to copy
+static uint32_t compact_offset;		// offset of the next record in compact_sector
+static uint16_t compact_index[256];	// the record index for compact_sector
+static bool compact_done = false;	// nothing was written since the last compaction
+
+static struct {
+	bool used;
+	uint8_t key;
+	uint8_t length;
+	uint8_t data[FLASH_STORE_MAX_DATA];
+} Pending[FLASH_STORE_PENDING];
+
+static const uint8_t * sector_address(int sector)
+{
+	return (const uint8_t *)(XIP_BASE + FLASH_STORE_OFFSET + sector * FLASH_SECTOR_SIZE);
+}
+
+uint16_t crc16_ccitt(uint16_t crc, const uint8_t * data, uint32_t length)
+{  // CRC-16/CCITT with polynomial 0x1021. Start with crc 0xFFFF.
+	int i;
+
+	while (length--) {
+		crc ^= (uint16_t)*data++ << 8;
+		for (i = 0; i < 8; i++)
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+static uint16_t record_crc(uint8_t key, uint8_t length, const uint8_t * data)
+{
+	uint8_t kl[2] = {key, length};
+
+	return crc16_ccitt(crc16_ccitt(0xFFFF, kl, 2), data, length);
+}
+
+// Program bytes at any offset in the store. Erased flash is all ones, and programming a one
+// leaves a bit unchanged, so each page is filled with 0xFF around the new data.
+static void flash_store_program(uint32_t offset, const uint8_t * data, uint32_t length)
+{
+	static uint8_t page[FLASH_PAGE_SIZE];
+	uint32_t page_offset, start, count, ints;
+
+	while (length) {
+		page_offset = offset & ~(FLASH_PAGE_SIZE - 1);
+		start = offset - page_offset;
+		count = FLASH_PAGE_SIZE - start;
+		if (count > length)
+			count = length;
+		memset(page, 0xFF, FLASH_PAGE_SIZE);
+		memcpy(page + start, data, count);
+		ints = save_and_disable_interrupts();
+		flash_range_program(FLASH_STORE_OFFSET + page_offset, page, FLASH_PAGE_SIZE);
+		restore_interrupts(ints);
+		offset += count;
+		data += count;
+		length -= count;
+	}
+}
+
+static void flash_store_erase(int sector)
+{
+	uint32_t ints;
+
+	ints = save_and_disable_interrupts();
+	flash_range_erase(FLASH_STORE_OFFSET + sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
+	restore_interrupts(ints);
+}
+
+// Return true if the sector is all ones, so it can be programmed without an erase.
+static bool flash_store_erased(int sector)
+{
+	const uint32_t * word = (const uint32_t *)sector_address(sector);
+	int i;
+
+	for (i = 0; i < FLASH_SECTOR_SIZE / 4; i++)
+		if (word[i] != 0xFFFFFFFF)
+			return false;
+	return true;
+}
+
+// Return the sector for the next compaction.
+static int flash_store_next_sector(void)
+{
+	return active_sector < 0 ? 0 : (active_sector + 1) % FLASH_STORE_SECTORS;
+}
+
+// Scan the active sector and build the index. Return the offset of the first free byte.
+static uint32_t flash_store_scan(void)
+{
+	const uint8_t * base = sector_address(active_sector);
+	const struct flash_record_header * rec;
+	uint32_t offset = HEADER_SIZE;
+
+	memset(record_index, 0, sizeof(record_index));
+	while (offset + sizeof(struct flash_record_header) <= FLASH_SECTOR_SIZE) {
+		rec = (const struct flash_record_header *)(base + offset);
+		if (rec->key == 0xFF)		// erased flash, the end of the records
+			return offset;
+		if (offset + RECORD_SIZE(rec->length) > FLASH_SECTOR_SIZE)
+			break;
+		if (rec->crc == record_crc(rec->key, rec->length, (const uint8_t *)(rec + 1)))
+			record_index[rec->key] = rec->length ? offset : 0;
+		offset += RECORD_SIZE(rec->length);
+	}
+	return FLASH_SECTOR_SIZE;		// damaged or full, the next write will compact
+}
+
+// Find the active sector and build the index, and erase the other sectors for later compactions.
+// Call this once at the start of main() before the I2C bus starts.
+void flash_store_init(void)
+{
+	const struct flash_sector_header * head;
+	int sector;
+
+	active_sector = -1;
+	for (sector = 0; sector < FLASH_STORE_SECTORS; sector++) {
+		head = (const struct flash_sector_header *)sector_address(sector);
+		if (head->magic != FLASH_STORE_MAGIC || head->generation == 0xFFFFFFFF)
+			continue;
+		if (active_sector < 0 || head->generation > active_generation) {
+			active_sector = sector;
+			active_generation = head->generation;
+		}
+	}
+	if (active_sector >= 0)
+		write_offset = flash_store_scan();
+	else
+		memset(record_index, 0, sizeof(record_index));
+	for (sector = 0; sector < FLASH_STORE_SECTORS; sector++)
+		if (sector != active_sector && ! flash_store_erased(sector))
+			flash_store_erase(sector);
+}
+
+// Start to copy the current records to the next sector, and erase it if needed. This also formats an empty store.
+static void flash_store_compact_start(void)
+{
+	compact_sector = flash_store_next_sector();
+	if ( ! flash_store_erased(compact_sector))
+		flash_store_erase(compact_sector);
+	memset(compact_index, 0, sizeof(compact_index));
+	compact_key = 0;
+	compact_offset = HEADER_SIZE;
+}
+
+// Copy the next current record to the compact sector. When all are copied, make it the active sector.
+static void flash_store_compact_step(void)
+{
+	static uint8_t record[RECORD_SIZE(FLASH_STORE_MAX_DATA)];
+	const struct flash_record_header * rec;
+	struct flash_sector_header head;
+	uint32_t size;
+
+	for ( ; active_sector >= 0 && compact_key < 255; compact_key++) {
+		if ( ! record_index[compact_key])
+			continue;
+		rec = (const struct flash_record_header *)(sector_address(active_sector) + record_index[compact_key]);
+		size = RECORD_SIZE(rec->length);
+		memcpy(record, rec, size);	// copy to RAM, flash is not readable while programming
+		flash_store_program(compact_sector * FLASH_SECTOR_SIZE + compact_offset, record, size);
+		compact_index[compact_key++] = compact_offset;
+		compact_offset += size;
+		return;
+	}
+	// Write the header last. A power failure before this leaves the old sector active.
+	head.magic = FLASH_STORE_MAGIC;
+	head.generation = active_sector < 0 ? 1 : active_generation + 1;
+	flash_store_program(compact_sector * FLASH_SECTOR_SIZE, (const uint8_t *)&head, HEADER_SIZE);
+	active_sector = compact_sector;
+	active_generation = head.generation;
+	write_offset = compact_offset;
+	memcpy(record_index, compact_index, sizeof(record_index));
+	compact_sector = -1;
+	compact_done = true;
+}
+
+// Return the index of the staged write for this key, or -1.
+static int pending_find(uint8_t key)
+{
+	int i;
+
+	for (i = 0; i < FLASH_STORE_PENDING; i++)
+		if (Pending[i].used && Pending[i].key == key)
+			return i;
+	return -1;
+}
+
+// Read the value of a key into data. Return the length, or -1 if the key has no value.
+int flash_store_read(uint8_t key, void * data, uint8_t max_length)
+{
+	const struct flash_record_header * rec;
+	const uint8_t * value;
+	uint8_t length;
+	int i;
+
+	if ((i = pending_find(key)) >= 0) {	// a staged write is the current value
+		length = Pending[i].length;
+		value = Pending[i].data;
+	}
+	else if (active_sector >= 0 && record_index[key]) {
+		rec = (const struct flash_record_header *)(sector_address(active_sector) + record_index[key]);
+		length = rec->length;
+		value = (const uint8_t *)(rec + 1);
+	}
+	else {
+		return -1;
+	}
+	if (length == 0)
+		return -1;
+	if (length > max_length)
+		length = max_length;
+	memcpy(data, value, length);
+	return length;
+}
+
+// Stage a write of a key. A length of zero deletes the key. Return false if the staging area is full.
+// The value is written to flash later by flash_store_poll().
+bool flash_store_write(uint8_t key, const void * data, uint8_t length)
+{
+	int i;
+
+	if (key == 0xFF || length > FLASH_STORE_MAX_DATA)
+		return false;
+	if ((i = pending_find(key)) < 0) {
+		for (i = 0; i < FLASH_STORE_PENDING; i++)
+			if ( ! Pending[i].used)
+				break;
+		if (i >= FLASH_STORE_PENDING)
+			return false;
+	}
+	Pending[i].key = key;
+	Pending[i].length = length;
+	memcpy(Pending[i].data, data, length);
+	Pending[i].used = true;
+	return true;
+}
+
+// Write one staged record to flash if it is safe to do so. Call this in the polling loop.
+void flash_store_poll(void)
+{
+	static uint8_t record[RECORD_SIZE(FLASH_STORE_MAX_DATA)];
+	struct flash_record_header * rec = (struct flash_record_header *)record;
+	uint32_t quiet_ms, size;
+	int i;
+
+	for (i = 0; i < FLASH_STORE_PENDING; i++)
+		if (Pending[i].used)
+			break;
+	if (i >= FLASH_STORE_PENDING)
+		return;
+	if ( ! gpio_get(GPIO13_EXTTR))		// EXTTR is low for transmit
+		return;
+	quiet_ms = (time_us_32() - i2c_activity_us) / 1000;
+	if (quiet_ms < FLASH_STORE_QUIET_MS)
+		return;
+	if (compact_sector >= 0) {		// continue the compaction
+		flash_store_compact_step();
+		return;
+	}
+	size = RECORD_SIZE(Pending[i].length);
+	if (active_sector < 0 || write_offset + size > FLASH_SECTOR_SIZE) {
+		if (compact_done && active_sector >= 0) {	// the store is full
+			Pending[i].used = false;
+			return;
+		}
+		if (quiet_ms < FLASH_STORE_ERASE_QUIET_MS && ! flash_store_erased(flash_store_next_sector()))
+			return;
+		flash_store_compact_start();
+		return;		// copy the records and write this record in later polls
+	}
+	memset(record, 0xFF, sizeof(record));
+	rec->key = Pending[i].key;
+	rec->length = Pending[i].length;
+	rec->crc = record_crc(rec->key, rec->length, Pending[i].data);
+	memcpy(rec + 1, Pending[i].data, Pending[i].length);
+	flash_store_program(active_sector * FLASH_SECTOR_SIZE + write_offset, record, size);
+	record_index[rec->key] = rec->length ? write_offset : 0;
+	write_offset += size;
+	Pending[i].used = false;
+	compact_done = false;
+}
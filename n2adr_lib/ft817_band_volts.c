@@ -8,10 +8,58 @@
 #include "../hl2ioboard.h"
 #include "../i2c_registers.h"
 
+// Band voltage maps. Each map ends with band code zero.
+static const struct band_volts_map ft817_map[] = {
+	{BAND_160, 330}, {BAND_80, 670}, {BAND_60, 830}, {BAND_40, 1000}, {BAND_30, 1330},
+	{BAND_20, 1670}, {BAND_17, 2000}, {BAND_15, 2330}, {BAND_12, 2670}, {BAND_10, 3000},
+	{BAND_6, 3330}, {BAND_2, 3670}, {BAND_70cm, 4000}, {0, 0}
+};
+
+static const struct band_volts_map xiegu_map[] = {
+	{BAND_160, 230}, {BAND_80, 460}, {BAND_60, 690}, {BAND_40, 920}, {BAND_30, 1150},
+	{BAND_20, 1380}, {BAND_17, 1610}, {BAND_15, 1840}, {BAND_12, 2070}, {BAND_10, 2300}, {0, 0}
+};
+
+// Icom band data voltages are the centers of the ranges. The 160, 80, 60 and 40 meter voltages of 7.5, 6.25
+// and 5.25 volts are above the 5 volt maximum of J4 pin 8. Limiting them to 5 volts would select the wrong
+// band, so those bands are left out of the map and output zero volts, the same as an unknown band.
+static const struct band_volts_map icom_map[] = {
+	{BAND_30, 4250}, {BAND_20, 4250}, {BAND_17, 3250}, {BAND_15, 3250}, {BAND_12, 2250},
+	{BAND_10, 2250}, {BAND_6, 1450}, {0, 0}
+};
+
+// Return the millivolts for a band in a band voltage standard, or zero for an unknown band.
+uint16_t band_volts_millivolts(uint8_t standard, uint8_t band_code)
+{
+	const struct band_volts_map * map;
+
+	switch (standard) {
+	case BAND_VOLTS_XIEGU:
+		map = xiegu_map;
+		break;
+	case BAND_VOLTS_ICOM:
+		map = icom_map;
+		break;
+	default:
+		map = ft817_map;
+		break;
+	}
+	for ( ; map->band; map++)
+		if (map->band == band_code)
+			return map->millivolts;
+	return 0;
+}
+
 void J4Pin8_millivolts(uint16_t millivolts)	// Maximum voltage is 5000 millivolts
 {
 	uint32_t level;
 
+	if (millivolts > 5000)
+		millivolts = 5000;
+	if (band_volts_running()) {	// use the high resolution output
+		band_volts_set(millivolts);
+		return;
+	}
 	level = FT817_WRAP * millivolts;
 	level = (level + 2500) / 5000;
 	if (level > FT817_WRAP)
@@ -22,88 +70,23 @@ void J4Pin8_millivolts(uint16_t millivolts)	// Maximum voltage is 5000 millivolt
 
 void ft817_band_volts(uint8_t band_code)	// Maximum voltage is 5000 mV
 {
-	switch (band_code) {
-	case BAND_160:
-		J4Pin8_millivolts(330);
-		break;
-	case BAND_80:
-		J4Pin8_millivolts(670);
-		break;
-	case BAND_60:
-		J4Pin8_millivolts(830);
-		break;
-	case BAND_40:
-		J4Pin8_millivolts(1000);
-		break;
-	case BAND_30:
-		J4Pin8_millivolts(1330);
-		break;
-	case BAND_20:
-		J4Pin8_millivolts(1670);
-		break;
-	case BAND_17:
-		J4Pin8_millivolts(2000);
-		break;
-	case BAND_15:
-		J4Pin8_millivolts(2330);
-		break;
-	case BAND_12:
-		J4Pin8_millivolts(2670);
-		break;
-	case BAND_10:
-		J4Pin8_millivolts(3000);
-		break;
-	case BAND_6:
-		J4Pin8_millivolts(3330);
-		break;
-	case BAND_2:
-		J4Pin8_millivolts(3670);
-		break;
-	case BAND_70cm:
-		J4Pin8_millivolts(4000);
-		break;
-	default:
-		J4Pin8_millivolts(0);
-		break;
-	}
+	J4Pin8_millivolts(band_volts_millivolts(BAND_VOLTS_FT817, band_code));
 }
 
 void xiegu_band_volts(uint8_t band_code)	// Maximum voltage is 5000 mV
 {
-	switch (band_code) {
-	case BAND_160:
-		J4Pin8_millivolts(230);
-		break;
-	case BAND_80:
-		J4Pin8_millivolts(460);
-		break;
-	case BAND_60:
-		J4Pin8_millivolts(690);
-		break;
-	case BAND_40:
-		J4Pin8_millivolts(920);
-		break;
-	case BAND_30:
-		J4Pin8_millivolts(1150);
-		break;
-	case BAND_20:
-		J4Pin8_millivolts(1380);
-		break;
-	case BAND_17:
-		J4Pin8_millivolts(1610);
-		break;
-	case BAND_15:
-		J4Pin8_millivolts(1840);
-		break;
-	case BAND_12:
-		J4Pin8_millivolts(2070);
-		break;
-	case BAND_10:
-		J4Pin8_millivolts(2300);
-		break;
-	default:
-		J4Pin8_millivolts(0);
-		break;
-	}
+	J4Pin8_millivolts(band_volts_millivolts(BAND_VOLTS_XIEGU, band_code));
 }
 
+void icom_band_volts(uint8_t band_code)	// Maximum voltage is 5000 mV
+{
+	J4Pin8_millivolts(band_volts_millivolts(BAND_VOLTS_ICOM, band_code));
+}
+
+// Output the band voltage for the standard in REG_BAND_VOLTS_STANDARD, or for default_standard if it is zero.
+void band_volts_band(uint8_t band_code, uint8_t default_standard)
+{
+	uint8_t standard = Registers[REG_BAND_VOLTS_STANDARD];
+
+	J4Pin8_millivolts(band_volts_millivolts(standard ? standard : default_standard, band_code));
+}
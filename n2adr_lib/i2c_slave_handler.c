@@ -3,231 +3,347 @@
 //   It is licensed under the MIT license. See MIT.txt.
 
 // This is an interrupt service routine for I2C traffic. It must return quickly.
+// The register semantics are in register_write() and register_read() so the USB command channel can use them too.
 
 #include "../hl2ioboard.h"
 #include "../i2c_registers.h"
 
 uint8_t Registers[256];		// copy of registers written to the Pico
 irq_handler IrqHandler[256];	// call these handlers (if any) after a register is written
+static reset_handler ResetHandler[RESET_HANDLERS];	// call these after a reset with REG_CONTROL
 
 uint64_t new_tx_freq;
 uint8_t new_tx_fcode;
 bool rx_freq_changed;
 uint8_t rx_freq_high;
 uint8_t rx_freq_low;
+volatile uint32_t i2c_activity_us;	// time of the last I2C event, used to find a quiet bus
 
 static void CheckHPF(void);
 
-void i2c_slave_handler(i2c_inst_t *i2c, i2c_slave_event_t event)
-{  // Receive and send I2C traffic. This is an interrupt service routine so return quickly!
-	static uint8_t i2c_regs_control;		// the control (register) byte for receive or request
-	static uint8_t i2c_control_valid = false;	// is i2c_regs_control valid?
-	uint8_t data, gpio, code1, code2, fcode;
-	uint16_t adc;
+// Return true for registers that are not assigned in i2c_registers.h. Firmware may still use them.
+#define REG_UNASSIGNED(reg)	(((reg) >= 107 && (reg) <= 109) || (reg) == 111 || \
+	((reg) >= 124 && (reg) < REG_BANK_WINDOW) || \
+	((reg) >= REG_BANK_WINDOW + BANK_WINDOW_SIZE && (reg) < REG_STATUS) || (reg) > GPIO_DIRECT_BASE + 28)
+
+// Add a function to be called after a reset with REG_CONTROL zeroes the registers. Modules use it to set
+// their registers to the values they have after their start function. Return false if there is no room.
+bool register_add_reset_handler(reset_handler handler)
+{
 	int i;
 
-	switch (event) {
-	case I2C_SLAVE_RECEIVE: // master has written data and this slave receives it
-		data = i2c_read_byte_raw(i2c);
-		if ( ! i2c_control_valid) {	// the first byte is the control (register number)
-			i2c_regs_control = data;
-			i2c_control_valid = true;
-			fast_led_flasher();
+	for (i = 0; i < RESET_HANDLERS; i++) {
+		if (ResetHandler[i] == handler)
+			return true;
+		if (ResetHandler[i] == NULL) {
+			ResetHandler[i] = handler;
+			return true;
 		}
-		else if (i2c_regs_control >= GPIO_DIRECT_BASE && i2c_regs_control <= GPIO_DIRECT_BASE + 28) {	// direct write to a GPIO pin
-			Registers[i2c_regs_control] = data;
-			gpio = i2c_regs_control - GPIO_DIRECT_BASE;
-			if (gpio_get_function(gpio) == GPIO_FUNC_PWM)	// FAN_WRAP and FT817_WRAP are both equal to 1020
-				pwm_set_gpio_level(gpio, (uint16_t)data * 4);
-			else
-				gpio_put(gpio, data);
-			i2c_regs_control++;
-		}
-		else {
-			Registers[i2c_regs_control] = data;	// this writes read-only registers too
-			switch (i2c_regs_control) {
-			case REG_CONTROL:
-				if (data == 1) {	// perform a reset to power-up condition
-					for (i = 0; i < 256; i++)
-						Registers[i] = 0;
-					new_tx_freq = 0;
-					new_tx_fcode = 0;
-					rx_freq_changed = false;
-				}
-				break;
-			case REG_RF_INPUTS:		// How to use the external Rx input at J9
-				switch (data) {
-				case 0:		// Normal HL2 Rx input, J9 not used, Pure Signal at J10 available
-					gpio_put(GPIO03_INTTR, 0);
-					gpio_put(GPIO02_RF3, 0);
-					break;
-				case 1:		// Use J9 for Rx input, Pure Signal at J10 is not available
-					gpio_put(GPIO03_INTTR, 1);
-					gpio_put(GPIO02_RF3, 1);
-					break;
-				case 2:		// Use J9 for Rx input on Rx, use Pure Signal at J10 for Tx
-					gpio_put(GPIO03_INTTR, 1);
-					IrqRxTxChange(GPIO13_EXTTR, 0xc);
-					break;
-				}
+	}
+	return false;
+}
+
+// Write one register. This has the same effect as an I2C write of data to reg. It is called from the I2C
+// handler, and from other code with interrupts disabled.
+void register_write(uint8_t reg, uint8_t data)
+{
+	uint8_t gpio, code1, code2, fcode;
+	int i;
+
+	if (reg >= GPIO_DIRECT_BASE && reg <= GPIO_DIRECT_BASE + 28) {	// direct write to a GPIO pin
+		Registers[reg] = data;
+		gpio = reg - GPIO_DIRECT_BASE;
+		if (gpio == GPIO08_Out8 && band_volts_running())	// high resolution band volts, 255 is 5 volts
+			band_volts_set(((uint32_t)data * 5000 + 127) / 255);
+		else if (gpio_get_function(gpio) == GPIO_FUNC_PWM)	// FAN_WRAP and FT817_WRAP are both equal to 1020
+			pwm_set_gpio_level(gpio, (uint16_t)data * 4);
+		else
+			gpio_put(gpio, data);
+		trace_event(TRACE_I2C_WRITE, reg, data);
+		if (protect_tripped())	// a protection fault is latched
+			protect_drop_outputs();
+	}
+	else if (Registers[REG_BANK] && reg >= REG_BANK_WINDOW &&
+			reg < REG_BANK_WINDOW + BANK_WINDOW_SIZE) {	// write to a register bank
+		bank_write(reg, data);
+	}
+	else {
+		Registers[reg] = data;	// this writes read-only registers too
+		if (REG_UNASSIGNED(reg))
+			Stats[STATS_UNKNOWN_WRITES]++;
+		switch (reg) {
+		case REG_CONTROL:
+			if (data == 1) {	// perform a reset to power-up condition
+				for (i = 0; i < 256; i++)
+					Registers[i] = 0;
+				for (i = 0; i < RESET_HANDLERS && ResetHandler[i]; i++)	// restore the module registers
+					(ResetHandler[i])();
+				new_tx_freq = 0;
+				new_tx_fcode = 0;
+				rx_freq_changed = false;
+			}
+			break;
+		case REG_RF_INPUTS:		// How to use the external Rx input at J9
+			switch (data) {
+			case 0:		// Normal HL2 Rx input, J9 not used, Pure Signal at J10 available
+				gpio_put(GPIO03_INTTR, 0);
+				gpio_put(GPIO02_RF3, 0);
 				break;
-			case REG_FAN_SPEED:		// fan control
-				pwm_set_chan_level(FAN_SLICE, FAN_CHAN, (uint16_t)data * 4);
+			case 1:		// Use J9 for Rx input, Pure Signal at J10 is not available
+				gpio_put(GPIO03_INTTR, 1);
+				gpio_put(GPIO02_RF3, 1);
 				break;
-			case REG_TX_FREQ_BYTE0:		// Tx frequency, LSB
-				new_tx_freq = (uint64_t)data	// Thanks to Neil, G4BRK
-					| (uint64_t)Registers[REG_TX_FREQ_BYTE1] << 8
-					| (uint64_t)Registers[REG_TX_FREQ_BYTE2] << 16
-					| (uint64_t)Registers[REG_TX_FREQ_BYTE3] << 24
-					| (uint64_t)Registers[REG_TX_FREQ_BYTE4] << 32;
-				new_tx_fcode = hertz2fcode(new_tx_freq);
-				CheckHPF();
+			case 2:		// Use J9 for Rx input on Rx, use Pure Signal at J10 for Tx
+				gpio_put(GPIO03_INTTR, 1);
+				IrqRxTxChange(GPIO13_EXTTR, 0xc);
 				break;
-			case REG_FCODE_RX1:
-			case REG_FCODE_RX2:
-			case REG_FCODE_RX3:
-			case REG_FCODE_RX4:
-			case REG_FCODE_RX5:
-			case REG_FCODE_RX6:
-			case REG_FCODE_RX7:
-			case REG_FCODE_RX8:
-			case REG_FCODE_RX9:
-			case REG_FCODE_RX10:
-			case REG_FCODE_RX11:
-			case REG_FCODE_RX12:
-				code1 = code2 = 0;
-				for (i = REG_FCODE_RX1; i <= REG_FCODE_RX12; i++) {
-					fcode = Registers[i];
-					if (fcode != 0) {
-						if (fcode > code2)	// maximum fcode
-							code2 = fcode;
-						if (code1 == 0)		// minimum fcode
-							code1 = fcode;
-						else if (fcode < code1)
-							code1 = fcode;
-					}
+			}
+			break;
+		case REG_FAN_SPEED:		// fan control
+			pwm_set_chan_level(FAN_SLICE, FAN_CHAN, (uint16_t)data * 4);
+			break;
+		case REG_TX_FREQ_BYTE0:		// Tx frequency, LSB
+			new_tx_freq = (uint64_t)data	// Thanks to Neil, G4BRK
+				| (uint64_t)Registers[REG_TX_FREQ_BYTE1] << 8
+				| (uint64_t)Registers[REG_TX_FREQ_BYTE2] << 16
+				| (uint64_t)Registers[REG_TX_FREQ_BYTE3] << 24
+				| (uint64_t)Registers[REG_TX_FREQ_BYTE4] << 32;
+			fcode = hertz2fcode(new_tx_freq);
+			if (fcode != new_tx_fcode) {
+				Stats[STATS_BAND_CHANGES]++;
+				stats_tx_freq_us = time_us_32();
+			}
+			new_tx_fcode = fcode;
+			CheckHPF();
+			break;
+		case REG_FCODE_RX1:
+		case REG_FCODE_RX2:
+		case REG_FCODE_RX3:
+		case REG_FCODE_RX4:
+		case REG_FCODE_RX5:
+		case REG_FCODE_RX6:
+		case REG_FCODE_RX7:
+		case REG_FCODE_RX8:
+		case REG_FCODE_RX9:
+		case REG_FCODE_RX10:
+		case REG_FCODE_RX11:
+		case REG_FCODE_RX12:
+			code1 = code2 = 0;
+			for (i = REG_FCODE_RX1; i <= REG_FCODE_RX12; i++) {
+				fcode = Registers[i];
+				if (fcode != 0) {
+					if (fcode > code2)	// maximum fcode
+						code2 = fcode;
+					if (code1 == 0)		// minimum fcode
+						code1 = fcode;
+					else if (fcode < code1)
+						code1 = fcode;
 				}
-				rx_freq_low = code1;
-				rx_freq_high = code2;
-				rx_freq_changed = true;
-				CheckHPF();
-				break;
-			case REG_OUT_PINS:
-				if (gpio_get_function(GPIO08_Out8) == GPIO_FUNC_SIO)
-					gpio_put(GPIO08_Out8, data & 0x80);
-				gpio_put(GPIO09_Out7, data & 0x40);
-				gpio_put(GPIO22_Out6, data & 0x20);
-				gpio_put(GPIO10_Out5, data & 0x10);
-				gpio_put(GPIO11_Out4, data & 0x08);
-				gpio_put(GPIO20_Out3, data & 0x04);
-				gpio_put(GPIO19_Out2, data & 0x02);
-				if (gpio_get_function(GPIO16_Out1) == GPIO_FUNC_SIO)
-					gpio_put(GPIO16_Out1, data & 0x01);
-				break;
-			case REG_STATUS:
-				gpio_put(GPIO12_Sw5, data & 0x01);
-				gpio_put(GPIO01_Sw12, data & 0x02);
-				break;
 			}
-			if (IrqHandler[i2c_regs_control])
-				(IrqHandler[i2c_regs_control])(i2c_regs_control, data);
-			i2c_regs_control++;
-		}
-		break;
-	case I2C_SLAVE_REQUEST: // master is requesting data
-		data = 0;
-		switch (i2c_regs_control) {
-		case REG_FIRMWARE_MAJOR:
-			data = firmware_version_major;
+			rx_freq_low = code1;
+			rx_freq_high = code2;
+			rx_freq_changed = true;
+			CheckHPF();
 			break;
-		case REG_FIRMWARE_MINOR:
-			data = firmware_version_minor;
+		case REG_OUT_PINS:
+			if (gpio_get_function(GPIO08_Out8) == GPIO_FUNC_SIO)
+				gpio_put(GPIO08_Out8, data & 0x80);
+			gpio_put(GPIO09_Out7, data & 0x40);
+			gpio_put(GPIO22_Out6, data & 0x20);
+			gpio_put(GPIO10_Out5, data & 0x10);
+			gpio_put(GPIO11_Out4, data & 0x08);
+			gpio_put(GPIO20_Out3, data & 0x04);
+			gpio_put(GPIO19_Out2, data & 0x02);
+			if (gpio_get_function(GPIO16_Out1) == GPIO_FUNC_SIO)
+				gpio_put(GPIO16_Out1, data & 0x01);
 			break;
-		case REG_IN_PINS:
-			if (gpio_get_function(GPIO08_Out8) != GPIO_FUNC_SIO)
-				data |= 0x80;
-			if (gpio_get_function(GPIO16_Out1) != GPIO_FUNC_SIO)
-				data |= 0x40;
-			// fall through
-		case REG_INPUT_PINS:			// return the state of the input pins
-			if (gpio_get(GPIO06_In5))
-				data |= 1 << 5;
-			if (gpio_get(GPIO07_In4))
-				data |= 1 << 4;
-			if (gpio_get(GPIO21_In3))
-				data |= 1 << 3;
-			if (gpio_get(GPIO18_In2))
-				data |= 1 << 2;
-			if (gpio_get_function(GPIO17_In1) == GPIO_FUNC_SIO && gpio_get(GPIO17_In1))
-				data |= 1 << 1;
-			if (gpio_get(GPIO13_EXTTR))	// 1 for receive, 0 for transmit
-				data |= 1;
+		case REG_STATUS:
+			gpio_put(GPIO12_Sw5, data & 0x01);
+			gpio_put(GPIO01_Sw12, data & 0x02);
 			break;
-		case REG_ADC0_MSB:			// perform an ADC conversion
+		}
+		trace_event(TRACE_I2C_WRITE, reg, data);
+		if (IrqHandler[reg])
+			(IrqHandler[reg])(reg, data);
+		if (protect_tripped())	// a protection fault is latched
+			protect_drop_outputs();
+	}
+}
+
+// Return the value of one register. This has the same effect as an I2C read of reg. It is called from the I2C
+// handler, and from other code with interrupts disabled.
+uint8_t register_read(uint8_t reg)
+{
+	uint8_t data, gpio;
+	uint16_t adc;
+
+	data = 0;
+	switch (reg) {
+	case REG_FIRMWARE_MAJOR:
+		data = firmware_version_major;
+		break;
+	case REG_FIRMWARE_MINOR:
+		data = firmware_version_minor;
+		break;
+	case REG_IN_PINS:
+		if (gpio_get_function(GPIO08_Out8) != GPIO_FUNC_SIO)
+			data |= 0x80;
+		if (gpio_get_function(GPIO16_Out1) != GPIO_FUNC_SIO)
+			data |= 0x40;
+		// fall through
+	case REG_INPUT_PINS:			// return the state of the input pins
+		if (gpio_get(GPIO06_In5))
+			data |= 1 << 5;
+		if (gpio_get(GPIO07_In4))
+			data |= 1 << 4;
+		if (gpio_get(GPIO21_In3))
+			data |= 1 << 3;
+		if (gpio_get(GPIO18_In2))
+			data |= 1 << 2;
+		if (gpio_get_function(GPIO17_In1) == GPIO_FUNC_SIO && gpio_get(GPIO17_In1))
+			data |= 1 << 1;
+		if (gpio_get(GPIO13_EXTTR))	// 1 for receive, 0 for transmit
+			data |= 1;
+		break;
+	case REG_ADC0_MSB:			// perform an ADC conversion, or use the ADC stream
+		if (adc_stream_running()) {
+			adc = adc_stream_latest[0];
+		}
+		else {
 			adc_select_input(0);
 			adc = adc_read();
-			Registers[i2c_regs_control] = data = adc >> 8;
-			Registers[i2c_regs_control + 1] = adc & 0xFF;
-			break;
-		case REG_ADC1_MSB:
+		}
+		Registers[reg] = data = adc >> 8;
+		Registers[reg + 1] = adc & 0xFF;
+		break;
+	case REG_ADC1_MSB:
+		if (adc_stream_running()) {
+			adc = adc_stream_latest[1];
+		}
+		else {
 			adc_select_input(1);
 			adc = adc_read();
-			Registers[i2c_regs_control] = data = adc >> 8;
-			Registers[i2c_regs_control + 1] = adc & 0xFF;
-			break;
-		case REG_ADC2_MSB:
+		}
+		Registers[reg] = data = adc >> 8;
+		Registers[reg + 1] = adc & 0xFF;
+		break;
+	case REG_ADC2_MSB:
+		if (adc_stream_running()) {
+			adc = adc_stream_latest[2];
+		}
+		else {
 			adc_select_input(2);
 			adc = adc_read();
-			Registers[i2c_regs_control] = data = adc >> 8;
-			Registers[i2c_regs_control + 1] = adc & 0xFF;
-			break;
-		case REG_OUT_PINS:
-			data = 0;
-			if (gpio_get_function(GPIO08_Out8) == GPIO_FUNC_SIO && gpio_get(GPIO08_Out8))
-				data |= 0x80;
-			if (gpio_get(GPIO09_Out7))
-				data |= 0x40;
-			if (gpio_get(GPIO22_Out6))
-				data |= 0x20;
-			if (gpio_get(GPIO10_Out5))
-				data |= 0x10;
-			if (gpio_get(GPIO11_Out4))
-				data |= 0x08;
-			if (gpio_get(GPIO20_Out3))
-				data |= 0x04;
-			if (gpio_get(GPIO19_Out2))
-				data |= 0x02;
-			if (gpio_get_function(GPIO16_Out1) == GPIO_FUNC_SIO && gpio_get(GPIO16_Out1))
-				data |= 0x01;
-			break;
-		case REG_STATUS:
-			data = 0;
-			if (gpio_get(GPIO12_Sw5))
-				data |= 0x01;
-			if (gpio_get(GPIO01_Sw12))
-				data |= 0x02;
-			if (gpio_get_function(GPIO17_In1) != GPIO_FUNC_SIO)
-				data |= 0x04;
-			break;
-		default:
-			if (i2c_regs_control >= GPIO_DIRECT_BASE && i2c_regs_control <= GPIO_DIRECT_BASE + 28) {	// direct read from a GPIO pin
-				gpio = i2c_regs_control - GPIO_DIRECT_BASE;
-				if (gpio_get_function(gpio) != GPIO_FUNC_SIO)
-					data = Registers[i2c_regs_control];
-				else if (gpio_get(gpio))
-					data = 1;
-				else
-					data = 0;
-			}
-			else {
-				data = Registers[i2c_regs_control];
-			}
-			break;
 		}
+		Registers[reg] = data = adc >> 8;
+		Registers[reg + 1] = adc & 0xFF;
+		break;
+	case REG_FILTER_ADC0_MSB:		// copy the filter value to the registers
+	case REG_FILTER_ADC1_MSB:
+	case REG_FILTER_ADC2_MSB:
+		adc_filter_registers((reg - REG_FILTER_ADC0_MSB) / 2);
+		data = Registers[reg];
+		break;
+	case REG_CHANGE_SEQ_MSB:		// copy the change counter and bitmap to the registers
+		change_track_registers();
+		data = Registers[reg];
+		break;
+	case REG_TRACE_SEQ_MSB:			// copy the trace sequence number to the registers
+		trace_registers();
+		data = Registers[reg];
+		break;
+	case REG_METER_FWD_MSB:			// copy the meter values to the meter registers
+	case REG_METER_REV_MSB:
+	case REG_METER_PEP_MSB:
+		meter_registers();
+		data = Registers[reg];
+		break;
+	case REG_OUT_PINS:
+		data = 0;
+		if (gpio_get_function(GPIO08_Out8) == GPIO_FUNC_SIO && gpio_get(GPIO08_Out8))
+			data |= 0x80;
+		if (gpio_get(GPIO09_Out7))
+			data |= 0x40;
+		if (gpio_get(GPIO22_Out6))
+			data |= 0x20;
+		if (gpio_get(GPIO10_Out5))
+			data |= 0x10;
+		if (gpio_get(GPIO11_Out4))
+			data |= 0x08;
+		if (gpio_get(GPIO20_Out3))
+			data |= 0x04;
+		if (gpio_get(GPIO19_Out2))
+			data |= 0x02;
+		if (gpio_get_function(GPIO16_Out1) == GPIO_FUNC_SIO && gpio_get(GPIO16_Out1))
+			data |= 0x01;
+		break;
+	case REG_STATUS:
+		data = 0;
+		if (gpio_get(GPIO12_Sw5))
+			data |= 0x01;
+		if (gpio_get(GPIO01_Sw12))
+			data |= 0x02;
+		if (gpio_get_function(GPIO17_In1) != GPIO_FUNC_SIO)
+			data |= 0x04;
+		break;
+	default:
+		if (reg >= GPIO_DIRECT_BASE && reg <= GPIO_DIRECT_BASE + 28) {	// direct read from a GPIO pin
+			gpio = reg - GPIO_DIRECT_BASE;
+			if (gpio_get_function(gpio) != GPIO_FUNC_SIO)
+				data = Registers[reg];
+			else if (gpio_get(gpio))
+				data = 1;
+			else
+				data = 0;
+		}
+		else if (Registers[REG_BANK] && reg >= REG_BANK_WINDOW &&
+				reg < REG_BANK_WINDOW + BANK_WINDOW_SIZE) {	// read from a register bank
+			data = bank_read(reg);
+		}
+		else {
+			data = Registers[reg];
+		}
+		break;
+	}
+	return data;
+}
+
+void i2c_slave_handler(i2c_inst_t *i2c, i2c_slave_event_t event)
+{  // Receive and send I2C traffic. This is an interrupt service routine so return quickly!
+	static uint8_t i2c_regs_control;		// the control (register) byte for receive or request
+	static uint8_t i2c_control_valid = false;	// is i2c_regs_control valid?
+	static bool i2c_had_data = false;	// was a byte read or written since the last stop or restart?
+	uint8_t data;
+
+	i2c_activity_us = time_us_32();
+	switch (event) {
+	case I2C_SLAVE_RECEIVE: // master has written data and this slave receives it
+		data = i2c_read_byte_raw(i2c);
+		i2c_had_data = true;
+		Stats[STATS_I2C_WRITTEN]++;
+		if ( ! i2c_control_valid) {	// the first byte is the control (register number)
+			i2c_regs_control = data;
+			i2c_control_valid = true;
+			fast_led_flasher();
+		}
+		else {
+			register_write(i2c_regs_control, data);
+			i2c_regs_control++;
+		}
+		break;
+	case I2C_SLAVE_REQUEST: // master is requesting data
+		i2c_had_data = true;
+		Stats[STATS_I2C_READ]++;
+		data = register_read(i2c_regs_control);
 		i2c_write_byte_raw(i2c, data);
 		i2c_regs_control++;
 		break;
 	case I2C_SLAVE_FINISH: // master has signalled Stop or Restart
+		if (i2c_had_data)
+			Stats[STATS_I2C_TRANSACTIONS]++;
+		else		// no data, such as an address probe or an abandoned transfer
+			Stats[STATS_I2C_EMPTY]++;
+		i2c_had_data = false;
 		i2c_control_valid = false;
 		break;
 	}
@@ -235,6 +351,10 @@ void i2c_slave_handler(i2c_inst_t *i2c, i2c_slave_event_t event)
 
 void IrqRxTxChange(uint gpio, uint32_t events)
 {  // Called when EXTTR changes
+	Stats[STATS_EXTTR_EDGES]++;
+	trace_event(TRACE_RX_TX, REG_INPUT_PINS, gpio_get(GPIO13_EXTTR));
+	if ( ! gpio_get(GPIO13_EXTTR))	// Tx
+		capture_trigger();
 	if (Registers[REG_RF_INPUTS] == 2) {
 		if (gpio_get(GPIO13_EXTTR))	// Rx
 			gpio_put(GPIO02_RF3, 1);
@@ -7,6 +7,8 @@
 // This implements an Icom AH-4 antenna tuner. The radio starts a tune by writing 1 or 2 to REG_ANTENNA_TUNER.
 // The radio monitors progress by reading the register REG_ANTENNA_TUNER.
 // Write 1 for a tune request, 2 to select bypass mode. Other tuners may have additional low numbered requests.
+// Write 3 to tune without checking the tuner cache. The AH-4 has no memory that can be recalled without RF,
+// so 1 and 3 are the same here, but the result of each tune is recorded in the tuner cache.
 // As tuning progresses, reading the register will show advancing numbers indicating progress.
 // These register values are fixed:
 //    Zero indicates a successful completion.
@@ -23,6 +25,8 @@ void IcomAh4(uint8_t AH4_START, uint8_t AH4_KEY)
 	uint8_t reg;
 	static uint8_t state_antenna_tuner = 0;
 	static absolute_time_t tuner_time0;
+	static bool tuning = false;
+	static uint8_t tune_fcode, tune_antenna;
 
 	// Timeout safety:
 	// Ensure the tuner does not remain in an active state indefinitely.
@@ -37,9 +41,12 @@ void IcomAh4(uint8_t AH4_START, uint8_t AH4_KEY)
 			// This state acts as the resting/default state for the state machine.
 			// It waits for the host to write a control value to REG_ANTENNA_TUNER.
 		reg = Registers[REG_ANTENNA_TUNER];
-		if (reg == 1 || reg == 2) {			// The user wrote 1 or 2. Otherwise do nothing.
-			state_antenna_tuner = reg;		// Go to state 1 or 2.
+		if (reg == 1 || reg == 2 || reg == 3) {		// The user wrote 1, 2 or 3. Otherwise do nothing.
+			state_antenna_tuner = reg == 3 ? 1 : reg;	// Go to state 1 or 2.
 			tuner_time0 = get_absolute_time ();	// Start timer.
+			tuning = state_antenna_tuner == 1;
+			tune_fcode = new_tx_fcode;
+			tune_antenna = Registers[REG_ANTENNA] >> 4;
 		}
 		break;
 	case 1:		// The user wrote 1. Starting state for tuning.
@@ -106,4 +113,8 @@ void IcomAh4(uint8_t AH4_START, uint8_t AH4_KEY)
 		}
 		break;
 	}
+	if (tuning && state_antenna_tuner == 0) {	// The tune has finished. Record the result.
+		tuning = false;
+		tuner_cache_store(tune_fcode, tune_antenna, Registers[REG_ANTENNA_TUNER], 0);
+	}
 }
@@ -0,0 +1,192 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This is a power meter for a directional coupler on two ADC inputs. Start the ADC stream, and then call
+// meter_start() with the ADC channels for the reflected and forward voltages. Each ADC sample is converted
+// to power in units of 0.1 watts using a piecewise-linear calibration table of ADC values and powers.
+// Call meter_set_calibration() to use the table for your coupler.
+//
+// For the forward power the meter keeps the average, a peak that holds for REG_METER_HOLD times 10 ms and
+// then decays, and the PEP, which is the maximum power during the last hold time. All arithmetic is integer
+// and runs in the ADC interrupt. A read of REG_METER_FWD_MSB, REG_METER_REV_MSB or REG_METER_PEP_MSB copies
+// the current values to the meter registers, so one four byte read returns a consistent forward power and SWR.
+
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+#define METER_AVG_SHIFT		4	// average over 2**METER_AVG_SHIFT samples
+#define METER_HOLD_DEFAULT	100	// default hold time in units of 10 ms
+#define METER_DECAY_DEFAULT	2	// default peak decay of 1/2**decay for each 10 ms
+#define METER_DECAY_MAX		31	// the largest shift of a 32-bit power
+
+// The default table is a square law detector with 100 watts at full scale.
+static const struct meter_point default_table[] = {
+	{0, 0}, {512, 16}, {1024, 63}, {1536, 141}, {2048, 250},
+	{2560, 391}, {3072, 563}, {3584, 766}, {4095, 1000}
+};
+
+static const struct meter_point * fwd_table = default_table;
+static uint8_t fwd_table_length = sizeof(default_table) / sizeof(default_table[0]);
+static const struct meter_point * rev_table = default_table;
+static uint8_t rev_table_length = sizeof(default_table) / sizeof(default_table[0]);
+
+static uint8_t rev_channel, fwd_channel;
+static bool meter_running = false;
+static uint32_t fwd_avg, rev_avg;		// average power times 16
+static uint16_t fwd_peak, fwd_pep, pep_max;
+static uint32_t peak_time_us, decay_time_us, pep_time_us;
+
+// Convert an ADC sample to power by linear interpolation in the table. Samples above the
+// table use the slope of the last segment.
+static uint16_t meter_interpolate(const struct meter_point * table, uint8_t length, uint16_t sample)
+{
+	const struct meter_point * p0, * p1;
+	int32_t power;
+	int i;
+
+	if (length < 2)
+		return 0;
+	for (i = 1; i < length - 1; i++)
+		if (sample < table[i].adc)
+			break;
+	p0 = table + i - 1;
+	p1 = table + i;
+	if (sample <= p0->adc)
+		return p0->power;
+	power = p0->power + ((int32_t)p1->power - p0->power) * ((int32_t)sample - p0->adc) / ((int32_t)p1->adc - p0->adc);
+	if (power < 0)
+		return 0;
+	if (power > 0xFFFF)
+		return 0xFFFF;
+	return power;
+}
+
+static uint32_t isqrt(uint32_t x)
+{
+	uint32_t root = 0, bit = 1UL << 30;
+
+	while (bit > x)
+		bit >>= 2;
+	while (bit) {
+		if (x >= root + bit) {
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+// This is called from the ADC interrupt for each sample.
+static void meter_adc_handler(uint8_t channel, uint16_t sample)
+{
+	uint32_t power, now, hold_us;
+	uint8_t decay;
+
+	if (channel == rev_channel) {
+		power = meter_interpolate(rev_table, rev_table_length, sample);
+		rev_avg = rev_avg - (rev_avg >> METER_AVG_SHIFT) + ((power << 4) >> METER_AVG_SHIFT);
+		return;
+	}
+	if (channel != fwd_channel)
+		return;
+	power = meter_interpolate(fwd_table, fwd_table_length, sample);
+	fwd_avg = fwd_avg - (fwd_avg >> METER_AVG_SHIFT) + ((power << 4) >> METER_AVG_SHIFT);
+	now = time_us_32();
+	hold_us = Registers[REG_METER_HOLD] ? Registers[REG_METER_HOLD] : METER_HOLD_DEFAULT;
+	hold_us *= 10000;
+	decay = Registers[REG_METER_DECAY] ? Registers[REG_METER_DECAY] : METER_DECAY_DEFAULT;
+	if (decay > METER_DECAY_MAX)
+		decay = METER_DECAY_MAX;
+	if (power >= fwd_peak) {	// a new peak
+		fwd_peak = power;
+		peak_time_us = decay_time_us = now;
+	}
+	else if (now - peak_time_us >= hold_us && now - decay_time_us >= 10000) {	// decay the peak
+		decay_time_us = now;
+		if ((fwd_peak >> decay) == 0)
+			fwd_peak = power;
+		else
+			fwd_peak -= fwd_peak >> decay;
+	}
+	if (power > pep_max)
+		pep_max = power;
+	if (now - pep_time_us >= hold_us) {	// the PEP is the maximum over the last hold time
+		fwd_pep = pep_max;
+		pep_max = 0;
+		pep_time_us = now;
+	}
+}
+
+// Start the meter using these ADC channels for the reflected and forward voltages.
+void meter_start(uint8_t reverse_channel, uint8_t forward_channel)
+{
+	rev_channel = reverse_channel;
+	fwd_channel = forward_channel;
+	fwd_avg = rev_avg = 0;
+	fwd_peak = fwd_pep = pep_max = 0;
+	peak_time_us = decay_time_us = pep_time_us = time_us_32();
+	meter_running = adc_stream_add_handler(meter_adc_handler);
+}
+
+// Use this calibration table for the forward or reflected power. The table must be in increasing order
+// of ADC value and must remain valid while the meter runs.
+void meter_set_calibration(bool forward, const struct meter_point * table, uint8_t length)
+{
+	if (forward) {
+		fwd_table = table;
+		fwd_table_length = length;
+	}
+	else {
+		rev_table = table;
+		rev_table_length = length;
+	}
+}
+
+// Return the power in 0.1 watts for a forward or reflected ADC sample.
+uint16_t meter_power(bool forward, uint16_t sample)
+{
+	if (forward)
+		return meter_interpolate(fwd_table, fwd_table_length, sample);
+	return meter_interpolate(rev_table, rev_table_length, sample);
+}
+
+// Return the SWR times 100 for these powers, or zero if there is no forward power.
+uint16_t meter_swr_x100(uint16_t forward, uint16_t reverse)
+{
+	uint32_t gamma, swr;
+
+	if (forward == 0)
+		return 0;
+	if (reverse >= forward)
+		return 9999;
+	gamma = isqrt(((uint32_t)reverse << 16) / forward * 256);	// reflection coefficient times 4096
+	swr = 100 * (4096 + gamma) / (4096 - gamma);
+	return swr > 9999 ? 9999 : swr;
+}
+
+// Copy the meter values to the meter registers. This is called from the I2C handler.
+void meter_registers(void)
+{
+	uint16_t fwd, rev, swr;
+
+	if ( ! meter_running)
+		return;
+	fwd = (fwd_avg + 8) >> 4;
+	rev = (rev_avg + 8) >> 4;
+	swr = meter_swr_x100(fwd, rev);
+	Registers[REG_METER_FWD_MSB] = fwd >> 8;
+	Registers[REG_METER_FWD_LSB] = fwd & 0xFF;
+	Registers[REG_METER_SWR_MSB] = swr >> 8;
+	Registers[REG_METER_SWR_LSB] = swr & 0xFF;
+	Registers[REG_METER_REV_MSB] = rev >> 8;
+	Registers[REG_METER_REV_LSB] = rev & 0xFF;
+	Registers[REG_METER_PEAK_MSB] = fwd_peak >> 8;
+	Registers[REG_METER_PEAK_LSB] = fwd_peak & 0xFF;
+	Registers[REG_METER_PEP_MSB] = fwd_pep >> 8;
+	Registers[REG_METER_PEP_LSB] = fwd_pep & 0xFF;
+}
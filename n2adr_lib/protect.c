@@ -0,0 +1,128 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This is a protection engine that checks each sample of the ADC stream against limits in the ADC interrupt.
+// The limits are the SWR in REG_PROTECT_SWR and a maximum value for each ADC in REG_PROTECT_ADC0 to REG_PROTECT_ADC2.
+// A limit of zero is not checked. When REG_PROTECT_COUNT samples in a row are over a limit, the protection trips.
+// It immediately drives the outputs in REG_PROTECT_OUTPUTS low, for example the amplifier PTT, and sets bits
+// in REG_FAULT. The fault is latched here, not in the register, so a stray host write or a REG_CONTROL reset
+// can not clear it. While it is latched the outputs are held low. The host clears the fault by writing
+// FAULT_CLEAR to REG_FAULT; other writes leave the fault bits in the register. The outputs given to
+// protect_start() are always dropped on a fault as well as those in REG_PROTECT_OUTPUTS. The time from the
+// ADC interrupt to the outputs going low is recorded in REG_PROTECT_TRIP_US_MSB/LSB. The time to detect a fault also depends on the ADC stream sample rate.
+//
+// Call protect_start() before adding any other ADC stream handlers so that the check is done first.
+// The SWR check uses the ratio of the reflected and forward voltages, so it assumes that the detector voltage
+// is proportional to the RF voltage.
+
+#include <hardware/irq.h>
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+#define PROTECT_FWD_MIN		64	// forward ADC samples below this are not checked for SWR
+
+static uint8_t rev_channel, fwd_channel;
+static uint16_t rev_sample;
+static uint8_t over_count[ADC_STREAM_CHANNELS];	// consecutive samples over the limit
+static uint8_t fixed_outputs;			// outputs dropped on a fault whatever REG_PROTECT_OUTPUTS is
+static volatile uint8_t fault_latch;		// the latched fault bits
+uint32_t protect_trips;				// total number of trips
+
+// Drive the protected outputs low. The bits are the same as REG_OUT_PINS.
+void protect_drop_outputs(void)
+{
+	static const uint8_t out_gpio[8] = {GPIO16_Out1, GPIO19_Out2, GPIO20_Out3, GPIO11_Out4,
+		GPIO10_Out5, GPIO22_Out6, GPIO09_Out7, GPIO08_Out8};
+	uint8_t outputs = Registers[REG_PROTECT_OUTPUTS] | fixed_outputs;
+	uint32_t mask = 0;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		if (outputs & (1 << i) && gpio_get_function(out_gpio[i]) == GPIO_FUNC_SIO)
+			mask |= 1 << out_gpio[i];
+	gpio_clr_mask(mask);
+}
+
+// This is called from the ADC interrupt for each sample.
+static void protect_adc_handler(uint8_t channel, uint16_t sample)
+{
+	uint8_t fault = 0, limit, count;
+	uint32_t latency;
+
+	if (fault_latch) {	// the fault is latched, so keep the outputs low
+		protect_drop_outputs();
+		return;
+	}
+	if (channel <= 2 && (limit = Registers[REG_PROTECT_ADC0 + channel]) && sample >= (uint16_t)limit << 4)
+		fault = 0x02 << channel;
+	if (channel == rev_channel) {
+		rev_sample = sample;
+	}
+	else if (channel == fwd_channel) {
+		// SWR > S is the same as rev / fwd > (S - 1) / (S + 1), and the limit is S times 10
+		limit = Registers[REG_PROTECT_SWR];
+		if (limit > 10 && sample >= PROTECT_FWD_MIN &&
+				(uint32_t)rev_sample * (limit + 10) > (uint32_t)sample * (limit - 10))
+			fault |= 0x01;
+	}
+	if ( ! fault) {
+		over_count[channel] = 0;
+		return;
+	}
+	count = Registers[REG_PROTECT_COUNT] ? Registers[REG_PROTECT_COUNT] : 1;
+	if (++over_count[channel] < count)
+		return;
+	protect_drop_outputs();
+	latency = time_us_32() - adc_stream_irq_us;
+	fault_latch = fault;
+	Registers[REG_FAULT] = fault;
+	if (latency > 0xFFFF)
+		latency = 0xFFFF;
+	Registers[REG_PROTECT_TRIP_US_MSB] = latency >> 8;
+	Registers[REG_PROTECT_TRIP_US_LSB] = latency & 0xFF;
+	over_count[channel] = 0;
+	protect_trips++;
+	trace_event(TRACE_FAULT, REG_FAULT, fault);
+}
+
+// This is the IrqHandler for a write to REG_FAULT.
+static void protect_fault_write(uint8_t reg, uint8_t data)
+{
+	int i;
+
+	if (data == FAULT_CLEAR) {
+		fault_latch = 0;
+		for (i = 0; i < ADC_STREAM_CHANNELS; i++)
+			over_count[i] = 0;
+	}
+	Registers[REG_FAULT] = fault_latch;
+}
+
+// A reset with REG_CONTROL does not clear a fault.
+static void protect_reset(void)
+{
+	Registers[REG_FAULT] = fault_latch;
+}
+
+// Start the protection engine using these ADC channels for the reflected and forward voltages.
+// The outputs are dropped on every fault, for example an amplifier PTT driven by the polling loop,
+// because the loop may be busy for a long time. The bits are the same as REG_OUT_PINS.
+// The ADC interrupt is given the highest priority so the I2C interrupt can not delay a trip.
+void protect_start(uint8_t reverse_channel, uint8_t forward_channel, uint8_t outputs)
+{
+	rev_channel = reverse_channel;
+	fwd_channel = forward_channel;
+	fixed_outputs = outputs;
+	IrqHandler[REG_FAULT] = protect_fault_write;
+	register_add_reset_handler(protect_reset);
+	irq_set_priority(ADC_IRQ_FIFO, PICO_HIGHEST_IRQ_PRIORITY);
+	adc_stream_add_handler(protect_adc_handler);
+}
+
+// Return true if a fault is latched. Firmware that drives a protected output itself should not
+// turn it on while this is true.
+bool protect_tripped(void)
+{
+	return fault_latch != 0;
+}
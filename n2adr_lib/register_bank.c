@@ -0,0 +1,75 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This exposes data larger than the 256 registers through a window of BANK_WINDOW_SIZE registers starting
+// at REG_BANK_WINDOW. Write a bank number to REG_BANK and a page number to REG_BANK_PAGE. Then the window
+// reads and writes bytes page * BANK_WINDOW_SIZE to page * BANK_WINDOW_SIZE + BANK_WINDOW_SIZE - 1 of the
+// bank data instead of the registers. REG_BANK_PAGES is the number of pages in the selected bank.
+// Bank 0 is the plain registers, so hosts that never write REG_BANK see no change, and the I2C handler
+// only calls these functions for the window registers when REG_BANK is not zero.
+//
+// Code that owns a data set calls bank_register() at startup with a bank number from hl2ioboard.h.
+// The data must remain valid. Bytes past the end of the data read as zero and writes to them are ignored.
+
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+struct register_bank {
+	uint8_t * data;
+	uint16_t length;
+	bool writable;
+};
+
+static struct register_bank Banks[BANK_COUNT];
+
+// Set the number of pages when a bank is selected.
+static void bank_select(uint8_t reg, uint8_t bank)
+{
+	uint32_t pages = 0;
+
+	if (bank < BANK_COUNT)
+		pages = (Banks[bank].length + BANK_WINDOW_SIZE - 1) / BANK_WINDOW_SIZE;
+	Registers[REG_BANK_PAGES] = pages > 255 ? 255 : pages;
+}
+
+// Add a data set as bank number "bank". Return false if the bank number is not valid.
+bool bank_register(uint8_t bank, void * data, uint16_t length, bool writable)
+{
+	if (bank == 0 || bank >= BANK_COUNT)
+		return false;
+	Banks[bank].data = data;
+	Banks[bank].length = length;
+	Banks[bank].writable = writable;
+	IrqHandler[REG_BANK] = bank_select;
+	return true;
+}
+
+// Return the bank data for a window register. This is called from the I2C handler.
+uint8_t bank_read(uint8_t reg)
+{
+	struct register_bank * bank;
+	uint32_t index;
+
+	if (Registers[REG_BANK] >= BANK_COUNT)
+		return 0;
+	bank = Banks + Registers[REG_BANK];
+	index = Registers[REG_BANK_PAGE] * BANK_WINDOW_SIZE + reg - REG_BANK_WINDOW;
+	if (index >= bank->length)
+		return 0;
+	return bank->data[index];
+}
+
+// Write bank data for a window register. This is called from the I2C handler.
+void bank_write(uint8_t reg, uint8_t data)
+{
+	struct register_bank * bank;
+	uint32_t index;
+
+	if (Registers[REG_BANK] >= BANK_COUNT)
+		return;
+	bank = Banks + Registers[REG_BANK];
+	index = Registers[REG_BANK_PAGE] * BANK_WINDOW_SIZE + reg - REG_BANK_WINDOW;
+	if (bank->writable && index < bank->length)
+		bank->data[index] = data;
+}
@@ -0,0 +1,76 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// These are performance counters. The counters in Stats[] are free running, and are indexed by the STATS_*
+// numbers in hl2ioboard.h. The I2C handler counts the I2C traffic, Tx band changes and EXTTR edges. Firmware
+// with a serial port counts its frames with stats_count(), and firmware that sets outputs for the Tx band calls
+// stats_outputs_applied() after setting them to measure the latency from the Tx frequency write.
+//
+// Write 1 to REG_STATS_CONTROL to copy the counters to a snapshot, or 2 to copy them and then clear them.
+// The snapshot is register bank BANK_STATS, with each counter four bytes least significant byte first.
+// REG_STATS_LATENCY_MSB/LSB is the last latency in microseconds.
+
+#include <string.h>
+#include <hardware/sync.h>
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+volatile uint32_t Stats[STATS_COUNT];
+static uint32_t StatsSnapshot[STATS_COUNT];
+volatile uint32_t stats_tx_freq_us;	// time of the last Tx band change, set in the I2C handler
+static uint8_t stats_band_changes;	// low byte of Stats[STATS_BAND_CHANGES] at the last stats_outputs_applied()
+
+// Copy the counters to the snapshot, and clear them for command 2. This is called from the I2C handler.
+static void stats_control(uint8_t reg, uint8_t data)
+{
+	uint32_t status;
+
+	if (data != 1 && data != 2)
+		return;
+	status = save_and_disable_interrupts();
+	memcpy(StatsSnapshot, (const void *)Stats, sizeof(StatsSnapshot));
+	if (data == 2)
+		memset((void *)Stats, 0, sizeof(StatsSnapshot));
+	restore_interrupts(status);
+	Registers[REG_STATS_CONTROL] = 0;
+}
+
+// This is also called after a reset with REG_CONTROL.
+static void stats_reset(void)
+{
+	Registers[REG_STATS_COUNT] = STATS_COUNT;
+}
+
+void stats_start(void)
+{
+	stats_reset();
+	register_add_reset_handler(stats_reset);
+	IrqHandler[REG_STATS_CONTROL] = stats_control;
+	bank_register(BANK_STATS, StatsSnapshot, sizeof(StatsSnapshot), false);
+}
+
+// Add one to a counter. Count each counter from only one interrupt handler or from the polling loop.
+void stats_count(uint8_t counter)
+{
+	if (counter < STATS_COUNT)
+		Stats[counter]++;
+}
+
+// Call this when the outputs for a new Tx band are set to record the latency from the Tx frequency write.
+void stats_outputs_applied(void)
+{
+	uint32_t latency;
+
+	if (stats_band_changes == (uint8_t)Stats[STATS_BAND_CHANGES])	// no band change since the last call
+		return;
+	stats_band_changes = Stats[STATS_BAND_CHANGES];
+	latency = time_us_32() - stats_tx_freq_us;
+	Stats[STATS_LATENCY_LAST] = latency;
+	if (latency > Stats[STATS_LATENCY_MAX])
+		Stats[STATS_LATENCY_MAX] = latency;
+	if (latency > 0xFFFF)
+		latency = 0xFFFF;
+	Registers[REG_STATS_LATENCY_MSB] = latency >> 8;
+	Registers[REG_STATS_LATENCY_LSB] = latency & 0xFF;
+}
@@ -0,0 +1,160 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This is an SWR estimator and a detector that decides when the SWR has settled during an antenna tune.
+// The estimator uses the reverse and forward voltages from the ADC stream, so start the stream and then
+// call swr_estimator_start() with the two ADC channels. SWR is calculated in integer arithmetic as
+// SWR times 100 and averaged over about eight samples in the ADC interrupt.
+//
+// Call swr_settle_start() when the tune transmission starts, and then swr_settle_poll() in the polling loop.
+// Every interval_ms the detector adds the average SWR to a window of SWR_WINDOW samples. The SWR is
+// stable when the change across the window (the slope) and the variance of the window are both small.
+// A stable SWR at or below swr_max is a match, and swr_settle_poll() returns true. A stable SWR above
+// swr_max returns true after stable_ms, because the tuner has given up. If the SWR readings are not
+// valid, for example because the ADC inputs are not wired, swr_settle_poll() never returns true and
+// the caller must use a timeout. Then call swr_settle_finish() to record the tune time and the SWR
+// in REG_TUNE_TIME_MSB/LSB and REG_TUNE_SWR.
+
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+#define SWR_FWD_MIN	8	// forward ADC samples below this are not valid
+#define SWR_MAX_X100	9999	// maximum SWR times 100
+#define SWR_AVG_SHIFT	3	// average over 2**SWR_AVG_SHIFT samples
+#define SWR_WINDOW	8	// number of detector samples in the window
+
+static uint8_t rev_channel, fwd_channel;
+static uint16_t rev_sample;
+static volatile uint32_t swr_avg;		// SWR times 100 times 16, or zero if not valid
+
+static const struct swr_settle_config * settle_config;
+static uint16_t settle_window[SWR_WINDOW];
+static uint8_t window_index, window_count;
+static uint32_t settle_start_ms, settle_sample_ms, stable_start_ms;
+static bool settle_stable;
+
+// This is called from the ADC interrupt for each sample. The reverse sample is taken before the forward sample.
+static void swr_adc_handler(uint8_t channel, uint16_t sample)
+{
+	uint32_t fwd, rev, swr;
+
+	if (channel == rev_channel) {
+		rev_sample = sample;
+		return;
+	}
+	if (channel != fwd_channel)
+		return;
+	fwd = sample;
+	rev = rev_sample;
+	if (fwd < SWR_FWD_MIN || rev > fwd) {
+		// The reverse voltage should never exceed the forward voltage. This probably means
+		// that the voltage readings aren't available because they haven't been wired up.
+		swr_avg = 0;
+		return;
+	}
+	if (rev == fwd)
+		swr = SWR_MAX_X100;
+	else
+		swr = (fwd + rev) * 100 / (fwd - rev);
+	if (swr > SWR_MAX_X100)
+		swr = SWR_MAX_X100;
+	if (swr_avg == 0)
+		swr_avg = swr << 4;
+	else
+		swr_avg = swr_avg - (swr_avg >> SWR_AVG_SHIFT) + ((swr << 4) >> SWR_AVG_SHIFT);
+}
+
+// Start the SWR estimator using these ADC channels for the reverse and forward voltages.
+void swr_estimator_start(uint8_t reverse_channel, uint8_t forward_channel)
+{
+	rev_channel = reverse_channel;
+	fwd_channel = forward_channel;
+	swr_avg = 0;
+	adc_stream_add_handler(swr_adc_handler);
+}
+
+// Return the average SWR times 100, or zero if the SWR is not valid.
+uint16_t swr_x100(void)
+{
+	return (swr_avg + 8) >> 4;
+}
+
+void swr_settle_start(const struct swr_settle_config * config)
+{
+	settle_config = config;
+	window_index = window_count = 0;
+	settle_stable = false;
+	settle_start_ms = settle_sample_ms = to_ms_since_boot(get_absolute_time());
+}
+
+// Return true when the SWR has settled. Call this in the polling loop.
+bool swr_settle_poll(void)
+{
+	uint32_t now, sum, variance;
+	int32_t slope, diff;
+	uint16_t swr, mean;
+	int i;
+
+	now = to_ms_since_boot(get_absolute_time());
+	if (now - settle_sample_ms < settle_config->interval_ms)
+		return false;
+	settle_sample_ms = now;
+	swr = swr_x100();
+	if (swr == 0) {		// not valid, so start again
+		window_count = 0;
+		settle_stable = false;
+		return false;
+	}
+	settle_window[window_index] = swr;
+	if (++window_index >= SWR_WINDOW)
+		window_index = 0;
+	if (window_count < SWR_WINDOW) {
+		window_count++;
+		return false;
+	}
+	// window_index is now the oldest sample
+	slope = (int32_t)swr - settle_window[window_index];
+	if (slope < 0)
+		slope = -slope;
+	sum = 0;
+	for (i = 0; i < SWR_WINDOW; i++)
+		sum += settle_window[i];
+	mean = sum / SWR_WINDOW;
+	variance = 0;
+	for (i = 0; i < SWR_WINDOW; i++) {
+		diff = (int32_t)settle_window[i] - mean;
+		variance += diff * diff;
+	}
+	variance /= SWR_WINDOW;
+	if (slope > settle_config->slope_max || variance > settle_config->variance_max) {
+		settle_stable = false;
+		return false;
+	}
+	if ( ! settle_stable) {
+		settle_stable = true;
+		stable_start_ms = now;
+	}
+	if (now - settle_start_ms < settle_config->min_ms)
+		return false;
+	if (swr <= settle_config->swr_max)
+		return true;		// a stable match
+	return now - stable_start_ms >= settle_config->stable_ms;	// stable but not matched
+}
+
+// Record the time since swr_settle_start() in REG_TUNE_TIME_MSB/LSB and the SWR times 10 in REG_TUNE_SWR.
+// Return the tune time in milliseconds.
+uint32_t swr_settle_finish(void)
+{
+	uint32_t tune_ms;
+	uint16_t swr;
+
+	tune_ms = to_ms_since_boot(get_absolute_time()) - settle_start_ms;
+	if (tune_ms > 0xFFFF)
+		tune_ms = 0xFFFF;
+	Registers[REG_TUNE_TIME_MSB] = tune_ms >> 8;
+	Registers[REG_TUNE_TIME_LSB] = tune_ms & 0xFF;
+	swr = (swr_x100() + 5) / 10;
+	Registers[REG_TUNE_SWR] = swr > 255 ? 255 : swr;
+	return tune_ms;
+}
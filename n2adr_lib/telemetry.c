@@ -0,0 +1,165 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This is a binary telemetry stream on the USB serial port. Each frame is:
+//   TELEMETRY_SYNC, type, length, length bytes of payload, CRC MSB, CRC LSB
+// The CRC is crc16_ccitt() with initial value 0xFFFF of the type, the length and the payload.
+// The payload starts with the time in microseconds, four bytes most significant byte first. Then:
+//   FRAME_REGISTERS: the block number n, then the sixteen registers 16 * n to 16 * n + 15.
+//   FRAME_ADC: ADC samples, two bytes each, with the channel in the high four bits.
+//   FRAME_TRACE: trace records, eight bytes each, as copied by trace_copy().
+//   FRAME_STATS: the performance counters, four bytes each, most significant byte first.
+// REG_TELEMETRY selects the frame types, and is zero for no telemetry. The ADC samples come from the ADC
+// stream and are decimated by REG_TELEMETRY_ADC_DIVIDE. Register frames need change_track_poll().
+// The host program software/telemetry.py decodes and records the stream.
+//
+// Frames are written with putchar_raw() so there is no CR/LF translation, and printf() output is mixed in with
+// them. The decoder skips it. The USB command channel in usb_command.c uses the same frames for its replies.
+// If the host does not read the port, the USB driver waits for a short time and then throws frames away.
+// Call telemetry_start() at startup after protect_start(), because it adds an ADC stream handler, and
+// telemetry_poll() in the polling loop.
+
+#include <stdio.h>
+#include <string.h>
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+#define TELEMETRY_MAX_DATA	200	// maximum payload after the time for telemetry frames
+#define TELEMETRY_ADC_RING	512	// must be a power of two
+#define TELEMETRY_ADC_FRAME	64	// maximum samples in one frame
+
+#define FRAME_REGISTERS		1	// frame types
+#define FRAME_ADC		2
+#define FRAME_TRACE		3
+#define FRAME_STATS		4
+
+static uint16_t AdcRing[TELEMETRY_ADC_RING];
+static volatile uint16_t ring_write, ring_read;
+static uint8_t adc_divide_count;
+static uint32_t trace_next;		// sequence number of the next trace record to send
+static uint32_t stats_time_ms;
+static bool telemetry_running = false;
+
+// Write one frame. The data is the payload after the time, at most USB_FRAME_MAX_DATA bytes.
+void telemetry_frame(uint8_t type, const uint8_t * data, uint8_t length)
+{
+	uint8_t frame[USB_FRAME_MAX_DATA + 9];
+	uint32_t now = time_us_32();
+	uint16_t crc;
+	int i, n = 0;
+
+	if (length > USB_FRAME_MAX_DATA)
+		return;
+	frame[n++] = TELEMETRY_SYNC;
+	frame[n++] = type;
+	frame[n++] = length + 4;
+	frame[n++] = now >> 24;
+	frame[n++] = now >> 16;
+	frame[n++] = now >> 8;
+	frame[n++] = now;
+	for (i = 0; i < length; i++)
+		frame[n++] = data[i];
+	crc = crc16_ccitt(0xFFFF, frame + 1, n - 1);
+	frame[n++] = crc >> 8;
+	frame[n++] = crc & 0xFF;
+	for (i = 0; i < n; i++)
+		putchar_raw(frame[i]);
+	stdio_flush();
+}
+
+// This is called from the ADC interrupt for each sample.
+static void telemetry_adc_handler(uint8_t channel, uint16_t sample)
+{
+	uint16_t next;
+
+	if ( ! (Registers[REG_TELEMETRY] & TELEMETRY_ADC))
+		return;
+	if (++adc_divide_count < Registers[REG_TELEMETRY_ADC_DIVIDE])
+		return;
+	adc_divide_count = 0;
+	next = (ring_write + 1) & (TELEMETRY_ADC_RING - 1);
+	if (next == ring_read) {		// the ring is full
+		if (Registers[REG_TELEMETRY_DROPPED] < 255)
+			Registers[REG_TELEMETRY_DROPPED]++;
+		return;
+	}
+	AdcRing[ring_write] = (uint16_t)channel << 12 | (sample & 0x0FFF);
+	ring_write = next;
+}
+
+void telemetry_start(void)
+{
+	trace_next = trace_sequence();
+	stats_time_ms = to_ms_since_boot(get_absolute_time());
+	adc_stream_add_handler(telemetry_adc_handler);
+	telemetry_running = true;
+}
+
+// Call this in the polling loop to send the frames.
+void telemetry_poll(void)
+{
+	uint8_t data[TELEMETRY_MAX_DATA];
+	uint8_t control = Registers[REG_TELEMETRY];
+	uint32_t now, seq, period;
+	uint16_t dirty, sample;
+	int i, n;
+
+	if ( ! telemetry_running)
+		return;
+	dirty = change_track_take();
+	if (control == 0)
+		return;
+	if (control & TELEMETRY_REGISTERS) {
+		for (i = 0; i < 16; i++) {
+			if (dirty & (1 << i)) {
+				data[0] = i;
+				memcpy(data + 1, Registers + i * 16, 16);
+				telemetry_frame(FRAME_REGISTERS, data, 17);
+			}
+		}
+	}
+	if (control & TELEMETRY_ADC) {
+		n = 0;
+		while (ring_read != ring_write && n < TELEMETRY_ADC_FRAME) {
+			sample = AdcRing[ring_read];
+			ring_read = (ring_read + 1) & (TELEMETRY_ADC_RING - 1);
+			data[n * 2] = sample >> 8;
+			data[n * 2 + 1] = sample & 0xFF;
+			n++;
+		}
+		if (n)
+			telemetry_frame(FRAME_ADC, data, n * 2);
+	}
+	else {
+		ring_read = ring_write;
+	}
+	seq = trace_sequence();
+	if (control & TELEMETRY_TRACE) {
+		if (seq - trace_next > TRACE_SIZE)	// records were lost
+			trace_next = seq - TRACE_SIZE;
+		n = trace_copy(trace_next, data, TELEMETRY_MAX_DATA / 8);
+		if (n) {
+			trace_next += n;
+			telemetry_frame(FRAME_TRACE, data, n * 8);
+		}
+	}
+	else {
+		trace_next = seq;
+	}
+	if (control & TELEMETRY_STATS) {
+		now = to_ms_since_boot(get_absolute_time());
+		period = Registers[REG_TELEMETRY_STATS_PERIOD] ? Registers[REG_TELEMETRY_STATS_PERIOD] : 10;
+		if (now - stats_time_ms >= period * 100) {
+			stats_time_ms = now;
+			for (i = 0; i < STATS_COUNT; i++) {
+				seq = Stats[i];
+				data[i * 4] = seq >> 24;
+				data[i * 4 + 1] = seq >> 16;
+				data[i * 4 + 2] = seq >> 8;
+				data[i * 4 + 3] = seq;
+			}
+			telemetry_frame(FRAME_STATS, data, STATS_COUNT * 4);
+		}
+	}
+}
@@ -0,0 +1,127 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This is an event trace in a RAM ring buffer of TRACE_SIZE records. Each record is eight bytes: the time in
+// microseconds, the event, a register number and a value. Interrupt handlers and state machines call
+// trace_event() to add a record. Each record has a sequence number, and the ring keeps the last TRACE_SIZE
+// records. The I2C handler adds a record for each register write, and T/R changes, protection trips and
+// state changes are added by their code.
+//
+// To read the trace, read REG_TRACE_SEQ_MSB/LSB for the low 16 bits of the sequence number of the next record,
+// and then read the ring as register bank BANK_TRACE. Those records are as stored in memory, with the time
+// least significant byte first, and record n is at index n modulo TRACE_SIZE. The low byte of the sequence
+// number in each record shows which records were overwritten during the read.
+//
+// There is only one core, so adding a record just reserves the slot with interrupts disabled for a few
+// instructions. The reader never waits, and a reader that falls behind by TRACE_SIZE records loses records.
+
+#include <string.h>
+#include <hardware/sync.h>
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+struct trace_record {
+	uint32_t time_us;
+	uint8_t event;
+	uint8_t reg;
+	uint8_t value;
+	uint8_t seq;		// low byte of the sequence number
+};
+
+static struct trace_record TraceRing[TRACE_SIZE];
+static volatile uint32_t trace_seq;	// sequence number of the next record
+
+// Add a record to the trace. This may be called from interrupts.
+void trace_event(uint8_t event, uint8_t reg, uint8_t value)
+{
+	struct trace_record * rec;
+	uint32_t status, seq;
+
+	if ( ! (Registers[REG_TRACE_CONTROL] & TRACE_ENABLE))
+		return;
+	if (event == TRACE_I2C_WRITE && ! (Registers[REG_TRACE_CONTROL] & TRACE_WRITES))
+		return;
+	status = save_and_disable_interrupts();
+	seq = trace_seq++;
+	rec = TraceRing + (seq & (TRACE_SIZE - 1));
+	rec->time_us = time_us_32();
+	rec->event = event;
+	rec->reg = reg;
+	rec->value = value;
+	rec->seq = seq & 0xFF;
+	restore_interrupts(status);
+}
+
+// Copy the sequence number to the registers. This is called from the I2C handler for a read of REG_TRACE_SEQ_MSB.
+void trace_registers(void)
+{
+	uint32_t seq = trace_seq;
+
+	Registers[REG_TRACE_SEQ_MSB] = seq >> 8;
+	Registers[REG_TRACE_SEQ_LSB] = seq & 0xFF;
+}
+
+// Return the sequence number of the next record.
+uint32_t trace_sequence(void)
+{
+	return trace_seq;
+}
+
+// Copy up to count records starting at sequence number first to buffer, eight bytes each, most significant
+// byte first. Stop at the first record that is not valid, and return the number of records copied.
+int trace_copy(uint32_t first, uint8_t * buffer, int count)
+{
+	struct trace_record * rec;
+	uint32_t seq, age;
+	int i;
+
+	seq = trace_seq;
+	for (i = 0; i < count; i++, buffer += 8) {
+		age = seq - (first + i);	// number of records written after this one, plus one
+		if (age == 0 || age > TRACE_SIZE)	// not written yet, or overwritten
+			break;
+		rec = TraceRing + ((first + i) & (TRACE_SIZE - 1));
+		buffer[0] = rec->time_us >> 24;
+		buffer[1] = rec->time_us >> 16;
+		buffer[2] = rec->time_us >> 8;
+		buffer[3] = rec->time_us;
+		buffer[4] = rec->event;
+		buffer[5] = rec->reg;
+		buffer[6] = rec->value;
+		buffer[7] = rec->seq;
+	}
+	return i;
+}
+
+// Write TRACE_CLEAR to REG_TRACE_CONTROL to empty the ring. The records are erased too, so a reader of the
+// bank does not take old records for new ones with the same low sequence bits.
+static void trace_control(uint8_t reg, uint8_t data)
+{
+	uint32_t status;
+
+	if (data & TRACE_CLEAR) {
+		status = save_and_disable_interrupts();
+		trace_seq = 0;
+		memset(TraceRing, 0, sizeof(TraceRing));
+		restore_interrupts(status);
+		Registers[REG_TRACE_CONTROL] = data & ~TRACE_CLEAR;
+	}
+}
+
+// Set the trace registers to their start values. This is also called after a reset with REG_CONTROL.
+static void trace_reset(void)
+{
+	Registers[REG_TRACE_CONTROL] = TRACE_ENABLE;
+	Registers[REG_TRACE_SIZE] = TRACE_BITS;
+}
+
+// Start the trace. Tracing is on, but register writes are not traced until TRACE_WRITES is set.
+void trace_start(void)
+{
+	trace_seq = 0;
+	trace_reset();
+	register_add_reset_handler(trace_reset);
+	IrqHandler[REG_TRACE_CONTROL] = trace_control;
+	bank_register(BANK_TRACE, TraceRing, sizeof(TraceRing), false);
+}
@@ -0,0 +1,218 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This is a memory of antenna tuner results. Each entry is keyed by the frequency code and the antenna,
+// and holds the tune result, the SWR and the time of the tune. When the memory is full, the least
+// recently used entry is replaced. Tuners that have their own memories can skip the tune cycle when
+// the frequency was already tuned. Write 3 to REG_ANTENNA_TUNER to force a full tune anyway.
+// REG_TUNER_CACHE is 0 to use the memory, 1 to ignore it, and 2 to clear it. A write of 2 is changed back to 0
+// by the I2C handler, and the memory is cleared in tuner_cache_poll().
+// The memory is saved in the flash store, so call tuner_cache_load() at startup to restore it. Changes are saved
+// by tuner_cache_poll() TUNER_CACHE_SAVE_MS after the last change, so several tunes in a row make one flash write.
+//
+// Firmware for an ATU with its own memories calls tuner_cache_tune_request() when its tune state machine is idle,
+// tuner_cache_tune_swr() with the final SWR, tuner_cache_bypass() when the ATU is bypassed, and
+// tuner_cache_tune_poll() with its state after each step. Call tuner_cache_poll() in the polling loop.
+
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+#define TUNER_CACHE_SAVE_MS	10000	// save this long after the last change
+
+static struct tuner_memory TunerCache[TUNER_CACHE_SIZE];
+static uint32_t tuner_cache_clock;	// increments for each use, for the LRU replacement
+static volatile bool clear_pending = false;	// REG_TUNER_CACHE was written with 2
+static bool save_pending = false;	// the memory changed and is not saved
+static uint32_t change_ms;		// time of the last change
+static bool atu_active = false;		// the ATU is active, not bypassed, so it uses its memories
+static bool tuning = false;		// a tune cycle is in progress
+static uint8_t tune_fcode, tune_antenna;
+static uint8_t tune_swr_x10;		// SWR times ten at the end of the tune, or zero
+
+// Save the entries in the flash store as fcode, antenna, result, swr_x10, least recently used first.
+static void tuner_cache_save(void)
+{
+	uint8_t data[TUNER_CACHE_SIZE * 4];
+	uint32_t last = 0, next;
+	int i, n = 0, found;
+
+	while (1) {		// find the entries in LRU order
+		next = 0xFFFFFFFF;
+		found = -1;
+		for (i = 0; i < TUNER_CACHE_SIZE; i++)
+			if (TunerCache[i].used > last && TunerCache[i].used < next) {
+				next = TunerCache[i].used;
+				found = i;
+			}
+		if (found < 0)
+			break;
+		data[n++] = TunerCache[found].fcode;
+		data[n++] = TunerCache[found].antenna;
+		data[n++] = TunerCache[found].result;
+		data[n++] = TunerCache[found].swr_x10;
+		last = next;
+	}
+	flash_store_write(FLASH_KEY_TUNER_CACHE, data, n);
+}
+
+// This is called from the I2C handler when REG_TUNER_CACHE is written.
+static void tuner_cache_control(uint8_t reg, uint8_t data)
+{
+	if (data == 2) {
+		clear_pending = true;
+		Registers[REG_TUNER_CACHE] = 0;
+	}
+}
+
+// Save the memory in a later poll.
+static void tuner_cache_changed(void)
+{
+	save_pending = true;
+	change_ms = to_ms_since_boot(get_absolute_time());
+}
+
+// Restore the entries from the flash store. The time of each entry is unknown, so it is set to zero.
+void tuner_cache_load(void)
+{
+	uint8_t data[TUNER_CACHE_SIZE * 4];
+	int i, length;
+
+	IrqHandler[REG_TUNER_CACHE] = tuner_cache_control;
+	tuner_cache_clear();
+	length = flash_store_read(FLASH_KEY_TUNER_CACHE, data, sizeof(data));
+	for (i = 0; i + 4 <= length; i += 4) {
+		TunerCache[i / 4].fcode = data[i];
+		TunerCache[i / 4].antenna = data[i + 1];
+		TunerCache[i / 4].result = data[i + 2];
+		TunerCache[i / 4].swr_x10 = data[i + 3];
+		TunerCache[i / 4].time_ms = 0;
+		TunerCache[i / 4].used = ++tuner_cache_clock;
+	}
+}
+
+void tuner_cache_clear(void)
+{
+	int i;
+
+	for (i = 0; i < TUNER_CACHE_SIZE; i++)
+		TunerCache[i].used = 0;
+	tuner_cache_clock = 0;
+}
+
+static struct tuner_memory * tuner_cache_find(uint8_t fcode, uint8_t antenna)
+{
+	int i;
+
+	for (i = 0; i < TUNER_CACHE_SIZE; i++)
+		if (TunerCache[i].used && TunerCache[i].fcode == fcode && TunerCache[i].antenna == antenna)
+			return TunerCache + i;
+	return NULL;
+}
+
+// Return the memory for this frequency and antenna, or NULL if there is none or the memory is not in use.
+struct tuner_memory * tuner_cache_lookup(uint8_t fcode, uint8_t antenna)
+{
+	struct tuner_memory * mem;
+
+	if (Registers[REG_TUNER_CACHE] != 0 || fcode == 0)
+		return NULL;
+	mem = tuner_cache_find(fcode, antenna);
+	if (mem)
+		mem->used = ++tuner_cache_clock;
+	return mem;
+}
+
+// Return true if there is a memory of a successful tune for this frequency and antenna.
+bool tuner_cache_is_tuned(uint8_t fcode, uint8_t antenna)
+{
+	struct tuner_memory * mem;
+
+	mem = tuner_cache_lookup(fcode, antenna);
+	return mem && mem->result == 0;
+}
+
+// Record the result of a tune. The result is the final value of REG_ANTENNA_TUNER, zero for success.
+void tuner_cache_store(uint8_t fcode, uint8_t antenna, uint8_t result, uint8_t swr_x10)
+{
+	struct tuner_memory * mem;
+	int i;
+
+	if (fcode == 0)
+		return;
+	mem = tuner_cache_find(fcode, antenna);
+	if ( ! mem) {		// replace an empty or the least recently used entry
+		mem = TunerCache;
+		for (i = 1; i < TUNER_CACHE_SIZE && mem->used; i++)
+			if (TunerCache[i].used < mem->used)
+				mem = TunerCache + i;
+	}
+	mem->fcode = fcode;
+	mem->antenna = antenna;
+	mem->result = result;
+	mem->swr_x10 = swr_x10;
+	mem->time_ms = to_ms_since_boot(get_absolute_time());
+	mem->used = ++tuner_cache_clock;
+	tuner_cache_changed();
+}
+
+// Call this in the polling loop.
+void tuner_cache_poll(void)
+{
+	if (clear_pending) {
+		clear_pending = false;
+		tuner_cache_clear();
+		tuner_cache_changed();
+	}
+	if (save_pending && to_ms_since_boot(get_absolute_time()) - change_ms >= TUNER_CACHE_SAVE_MS) {
+		save_pending = false;
+		tuner_cache_save();
+	}
+}
+
+// Call this when the tune state machine is idle. Return the state to start: 1 to tune, 2 to bypass the ATU,
+// or 0 for no request. REG_ANTENNA_TUNER is 1 to tune, 2 to bypass and 3 to tune without the tuner cache.
+// A tune of a frequency that the active ATU already tuned sets REG_ANTENNA_TUNER to 0 for success and returns 0.
+uint8_t tuner_cache_tune_request(void)
+{
+	uint8_t reg = Registers[REG_ANTENNA_TUNER];
+
+	if (reg == 1 && atu_active && tuner_cache_is_tuned(new_tx_fcode, Registers[REG_ANTENNA] >> 4)) {
+		Registers[REG_ANTENNA_TUNER] = 0;	// already tuned, the ATU will use its memory
+		return 0;
+	}
+	if (reg != 1 && reg != 2 && reg != 3)
+		return 0;
+	reg = reg == 3 ? 1 : reg;
+	tuning = reg == 1;
+	tune_fcode = new_tx_fcode;
+	tune_antenna = Registers[REG_ANTENNA] >> 4;
+	tune_swr_x10 = 0;
+	return reg;
+}
+
+// Record the SWR times ten at the end of the tune transmission.
+void tuner_cache_tune_swr(uint8_t swr_x10)
+{
+	tune_swr_x10 = swr_x10;
+}
+
+// Call this when the ATU is set to bypass.
+void tuner_cache_bypass(void)
+{
+	atu_active = false;
+}
+
+// Call this with the tune state after each step. When the tune cycle has finished, remember the result.
+void tuner_cache_tune_poll(uint8_t state)
+{
+	uint8_t result;
+
+	if ( ! tuning || state != 0)
+		return;
+	tuning = false;
+	result = Registers[REG_ANTENNA_TUNER];
+	if (result == 0)
+		atu_active = true;
+	tuner_cache_store(tune_fcode, tune_antenna, result, tune_swr_x10);
+}
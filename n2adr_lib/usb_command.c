@@ -0,0 +1,137 @@
+// This is firmware for the Hermes Lite 2 IO board designed by Jim Ahlstrom, N2ADR. It is
+//   Copyright (c) 2022-2023 James C. Ahlstrom <jahlstr@gmail.com>.
+//   It is licensed under the MIT license. See MIT.txt.
+
+// This is a command channel on the USB serial port. It reads and writes the registers with the same effect as
+// I2C, but many registers can be read and written in one transfer, so it is much faster than the HL2 I2C bridge.
+// Commands and replies use the telemetry frame format in telemetry.c:
+//   TELEMETRY_SYNC, type, length, length bytes of payload, CRC MSB, CRC LSB
+// The payload starts with four bytes of time. The host may send zero. A command frame has type FRAME_COMMAND
+// and its payload after the time is a tag and then a list of operations:
+//   USB_OP_WRITE, reg, count, count bytes: write the bytes to registers reg, reg + 1, ...
+//   USB_OP_READ, reg, count: read registers reg, reg + 1, ...
+// As with I2C, the register number increments after each byte and wraps at 256, and the window reads and
+// writes the register bank when REG_BANK is not zero. The operations are done in order. The reply has type
+// FRAME_REPLY and its payload after the time is the tag, a status and then the data from all the reads.
+// The status is USB_OK, or an error and then no operations were done. The host matches replies by the tag.
+//
+// Call usb_command_poll() in the polling loop. Each register access is made with interrupts disabled, so
+// it does not interfere with an I2C transfer in progress.
+
+#include "../hl2ioboard.h"
+#include "../i2c_registers.h"
+
+#define FRAME_COMMAND		0x10	// frame types
+#define FRAME_REPLY		0x11
+
+#define USB_OP_WRITE		1	// operations in a command
+#define USB_OP_READ		2
+
+#define USB_OK			0	// reply status
+#define USB_BAD_COMMAND		1	// an operation is not valid or is cut off
+#define USB_TOO_LONG		2	// the read data does not fit in the reply
+
+#define USB_COMMAND_TIMEOUT_US	100000	// throw away a partial frame after this time
+
+static uint8_t CommandBuffer[3 + 255 + 2];
+static int command_length;
+static uint32_t command_time_us;	// time of the last byte received
+
+// Check the operations and return the status and the number of bytes read.
+static uint8_t usb_command_check(const uint8_t * ops, int length, int * read_count)
+{
+	int i = 0;
+
+	*read_count = 0;
+	while (i < length) {
+		if (i + 3 > length)
+			return USB_BAD_COMMAND;
+		switch (ops[i]) {
+		case USB_OP_WRITE:
+			i += 3 + ops[i + 2];
+			if (i > length)
+				return USB_BAD_COMMAND;
+			break;
+		case USB_OP_READ:
+			*read_count += ops[i + 2];
+			i += 3;
+			break;
+		default:
+			return USB_BAD_COMMAND;
+		}
+	}
+	if (*read_count > USB_FRAME_MAX_DATA - 2)
+		return USB_TOO_LONG;
+	return USB_OK;
+}
+
+// Perform the operations in a command frame payload and send the reply.
+static void usb_command_run(const uint8_t * payload, int length)
+{
+	uint8_t reply[USB_FRAME_MAX_DATA];
+	const uint8_t * ops = payload + 5;	// skip the time and the tag
+	uint8_t reg, count;
+	uint32_t status;
+	int i, j, n, read_count;
+
+	fast_led_flasher();
+	length -= 5;
+	reply[0] = payload[4];	// the tag
+	reply[1] = usb_command_check(ops, length, &read_count);
+	n = 2;
+	if (reply[1] == USB_OK) {
+		for (i = 0; i < length; ) {
+			reg = ops[i + 1];
+			count = ops[i + 2];
+			if (ops[i] == USB_OP_WRITE) {
+				for (j = 0; j < count; j++, reg++) {
+					status = save_and_disable_interrupts();
+					register_write(reg, ops[i + 3 + j]);
+					restore_interrupts(status);
+				}
+				i += 3 + count;
+			}
+			else {
+				for (j = 0; j < count; j++, reg++) {
+					status = save_and_disable_interrupts();
+					reply[n++] = register_read(reg);
+					restore_interrupts(status);
+				}
+				i += 3;
+			}
+		}
+	}
+	telemetry_frame(FRAME_REPLY, reply, n);
+}
+
+// Call this in the polling loop to read and perform the commands.
+void usb_command_poll(void)
+{
+	uint32_t now = time_us_32();
+	uint16_t crc;
+	int ch, total;
+
+	if (command_length && now - command_time_us > USB_COMMAND_TIMEOUT_US)	// a partial frame
+		command_length = 0;
+	while ((ch = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+		command_time_us = now;
+		if (command_length == 0 && ch != TELEMETRY_SYNC)	// look for the start of a frame
+			continue;
+		CommandBuffer[command_length++] = ch;
+		if (command_length < 3)
+			continue;
+		if (CommandBuffer[2] < 5) {	// too short for the time and the tag
+			command_length = 0;
+			continue;
+		}
+		total = 3 + CommandBuffer[2] + 2;
+		if (command_length < total)
+			continue;
+		command_length = 0;
+		crc = CommandBuffer[total - 2] << 8 | CommandBuffer[total - 1];
+		if (CommandBuffer[1] != FRAME_COMMAND || crc16_ccitt(0xFFFF, CommandBuffer + 1, total - 3) != crc)
+			continue;
+		usb_command_run(CommandBuffer + 3, CommandBuffer[2]);
+		return;		// one command for each poll
+	}
+}
@@ -1,5 +1,10 @@
-import socket, select, struct, collections, time, os
+import socket, select, struct, collections, time, os, threading, json
 import shutil, tempfile, urllib.request, netifaces
+import telemetry
+try:
+  import serial, serial.tools.list_ports
+except ImportError:
+  serial = None
 
 # Send commands to the Hermes Lite 2 on port 1025.
 # Original author Steve Haynal, KF7O.
@@ -114,8 +119,11 @@ def discover(ifaddr=None, verbose=2):
     print("Trying port 1024. Only gateware update will work on units without port 1025 enabled.")
   return discover_by_port(ifaddr, 1024, verbose)
 
-def discover_all(verbose=2):
-  """Discover all HL2s on all interfaces and return list of their responses."""
+## The last radio found by discover_first(), for a fast reconnect
+LAST_RADIO_FILE = os.path.join(os.path.expanduser('~'), '.hermeslite_last_radio')
+
+def interface_addresses():
+  """Return a list of (address, name) for the IPv4 addresses of all interfaces except loopback."""
   # Use AF_INET because HL2 only supports IPv4 and not IPv6 
   PROTO = netifaces.AF_INET   
   # Fetch list of network interfaces, remove 'lo' if present
@@ -128,39 +136,352 @@ def discover_all(verbose=2):
   iface_addrs = [(d['addr'], t[1]) for t in if_addrs for d in t[0] \
     if 'addr' in d]
   # Keep interfaces that do not have 127.0.0.1 as an address (loopback)
-  iface_addrs = [ t for t in iface_addrs if t[0] != '127.0.0.1']
-  # Do discovery on all remaining interfaces that have IP addresses
+  return [ t for t in iface_addrs if t[0] != '127.0.0.1']
+
+def discover_concurrent(ifaddrs=None, ports=(1025,1024), timeout=1.0, expected_ip=None, first=False, verbose=2):
+  """Discover HL2s on all interfaces and ports at once and return a list of (address, response).
+  The discover message is broadcast on each interface in ifaddrs, a list of (address, name), and sent
+  directly to expected_ip. The replies are collected in one select loop until the timeout, or until
+  expected_ip answers, or until any radio answers if first is True. A radio that answers on several
+  ports is listed once with the first port in ports. Radios on a later port are only returned if no
+  radio answered on the first port, so gateware update can at least work."""
+  if ifaddrs is None:
+    ifaddrs = interface_addresses()
+  msg = bytes([0xEF,0xFE,0x02]+(57*[0]))
+  socks = []
+  for ifaddr, name in ifaddrs:
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    sock.setblocking(0)
+    try:
+      sock.bind((ifaddr, 0))
+      for port in ports:
+        sock.sendto(msg, ('255.255.255.255', port))
+    except OSError:
+      sock.close()
+      continue
+    if verbose >= 2:
+      print("Performing discovery: interface %s, IP %s" % (name, ifaddr))
+    socks.append(sock)
+  if expected_ip:
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setblocking(0)
+    try:
+      for port in ports:
+        sock.sendto(msg, (expected_ip, port))
+      socks.append(sock)
+    except OSError:
+      sock.close()
+  own = set(t[0] for t in ifaddrs)
+  found = {}	# the best (address, response) for each IP
+  end = time.time() + timeout
+  done = not socks
+  while not done:
+    wait = end - time.time()
+    if wait <= 0:
+      break
+    ready = select.select(socks, [], [], wait)
+    for sock in ready[0]:
+      try:
+        data, address = sock.recvfrom(60)
+      except OSError:
+        continue
+      if address[0] in own or address[1] not in ports: continue
+      r = decode(data)
+      if not r: continue
+      if verbose >= 2:
+        print("Discover response from %s:%d" %(address[0], address[1]))
+      old = found.get(address[0])
+      if old is None or ports.index(address[1]) < ports.index(old[0][1]):
+        found[address[0]] = (address, r)
+      if address[1] == ports[0] and (first or address[0] == expected_ip):
+        done = True
+  for sock in socks:
+    sock.close()
+  responses = list(found.values())
+  best = [t for t in responses if t[0][1] == ports[0]]
+  return best if best else responses
+
+def discover_all(verbose=2, ports=(1025,1024)):
+  """Discover all HL2s on all interfaces and return list of their responses."""
   responses = []
-  for ifa in iface_addrs: 
-    if verbose >= 2: 
-      print("\nPerforming discovery: interface %s, IP %s" % (ifa[1],ifa[0]))
-    d = discover(ifaddr=ifa[0],verbose=verbose)
-    if d != []:
-      for r in d:
-        if verbose >= 1: 
-          print('Discovered radio: IP %s MAC %s GW %s #RX %d' % 
-            (r[0][0],r[1].mac,r[1].gateware,r[1].receivers))
-        responses.append(r)
+  for r in discover_concurrent(ports=ports, verbose=verbose):
+    if verbose >= 1: 
+      print('Discovered radio: IP %s MAC %s GW %s #RX %d' % 
+        (r[0][0],r[1].mac,r[1].gateware,r[1].receivers))
+    responses.append(r)
   return responses
 
-def discover_first(verbose=2):
+def save_last_radio(address, response):
+  """Record the radio for a fast reconnect by discover_first()."""
+  try:
+    with open(LAST_RADIO_FILE, 'w') as fp:
+      fp.write("%s %d %s\n" % (address[0], address[1], response.mac))
+  except OSError:
+    pass
+
+def load_last_radio():
+  """Return the IP of the last radio found by discover_first(), or None."""
+  try:
+    with open(LAST_RADIO_FILE) as fp:
+      return fp.read().split()[0]
+  except (OSError, IndexError):
+    return None
+
+def discover_first(verbose=2, ip=None, ports=(1025,1024)):
   """Discover all HL2s on all interfaces and return the first HL2 found."""
   """Verbose can be >=2 (all output), 1 (only on discovery), or 0 (no output)"""
-  responses = discover_all(verbose)
+  """If ip is given, only that radio is tried. Otherwise the last radio found answers first if it is present."""
+  if ip:
+    responses = discover_concurrent(ifaddrs=[], ports=ports, expected_ip=ip, verbose=verbose)
+  else:
+    last = load_last_radio()
+    responses = discover_concurrent(ports=ports, expected_ip=last, first=last is None, verbose=verbose)
+    responses.sort(key=lambda t: t[0][0] != last)	# the last radio first
   if responses != []:
-    return HermesLite(responses[0][0])
+    r = responses[0]
+    if verbose >= 1: 
+      print('Discovered radio: IP %s MAC %s GW %s #RX %d' % 
+        (r[0][0],r[1].mac,r[1].gateware,r[1].receivers))
+    save_last_radio(r[0], r[1])
+    return HermesLite(r[0])
   else:
     return None
 
+## The IO board USB command channel, see n2adr_lib/usb_command.c
+IOBOARD_USB_VID = 0x2E8A	# Raspberry Pi Pico
+FRAME_COMMAND = 0x10
+FRAME_REPLY = 0x11
+USB_OP_WRITE = 1
+USB_OP_READ = 2
+USB_MAX_OPS = 240	# maximum bytes of operations in one command
+USB_MAX_READ = 249	# maximum bytes read in one command
+REG_BANK = 33
+REG_BANK_PAGE = 34
+REG_BANK_PAGES = 35
+REG_BANK_WINDOW = 128
+BANK_WINDOW_SIZE = 32
+
+def find_ioboard_usb():
+  """Return the names of the serial ports that may be an IO board connected by USB.
+  Any Raspberry Pi Pico has this USB vendor ID, so use HermesLite.open_ioboard_usb() to find the IO board of an HL2."""
+  if serial is None:
+    return []
+  return [port.device for port in serial.tools.list_ports.comports() if port.vid == IOBOARD_USB_VID]
+
+class IoBoardUSB:
+  """Read and write the IO board registers with the USB command channel.
+  This has the same effect as I2C, but many registers are read and written in one transfer."""
+  def __init__(self, port, timeout=0.5):
+    self.serial = serial.Serial(port, timeout=0.05, exclusive=True)	# not a port that telemetry.py is reading
+    self.timeout = timeout
+    self.decoder = telemetry.Decoder()
+    self.tag = 0
+
+  def close(self):
+    self.serial.close()
+
+  def transaction(self, ops):
+    """Perform a list of operations ('w', reg, data) and ('r', reg, count) and return the bytes read."""
+    body = bytearray()
+    for op in ops:
+      if op[0] == 'w':
+        body += bytes((USB_OP_WRITE, op[1] & 0xFF, len(op[2]))) + bytes(op[2])
+      else:
+        body += bytes((USB_OP_READ, op[1] & 0xFF, op[2]))
+    self.tag = (self.tag + 1) & 0xFF
+    payload = bytes(4) + bytes((self.tag,)) + body
+    frame = bytes((FRAME_COMMAND, len(payload))) + payload
+    crc = telemetry.crc16_ccitt(frame)
+    self.serial.write(bytes((telemetry.SYNC,)) + frame + bytes((crc >> 8, crc & 0xFF)))
+    end = time.time() + self.timeout
+    while time.time() < end:
+      for reply in self.decoder.feed(self.serial.read(self.serial.in_waiting or 1)):
+        if reply.type == FRAME_REPLY and reply.data[0:1] == bytes((self.tag,)):
+          if reply.data[1] != 0:
+            raise IOError("IO board USB command error %d" % reply.data[1])
+          return reply.data[2:]
+    raise IOError("No reply from the IO board USB port")
+
+  def write(self, addr, data):
+    """Write the bytes in data to registers addr, addr + 1, ..."""
+    for i in range(0, len(data), USB_MAX_OPS - 3):
+      self.transaction((('w', addr + i, data[i:i + USB_MAX_OPS - 3]),))
+
+  def read(self, addr, count):
+    """Read count registers starting at addr."""
+    data = b''
+    for i in range(0, count, USB_MAX_READ):
+      data += self.transaction((('r', addr + i, min(count - i, USB_MAX_READ)),))
+    return data
+
+class EngineCommand:
+  """One command for the CommandEngine. After the engine runs it, response is the HL2 response or None."""
+  def __init__(self,addr,cmd,check=None):
+    self.addr = addr
+    self.cmd = cmd
+    self.check = check		# function to test that a response is for this command, or None
+    self.msg = bytes([0xef,0xfe,0x05,0x7f,addr<<1])+cmd+bytes([0x0]*51)
+    self.response = None
+    self.sent = 0		# number of times sent
+    self.deadline = 0
+
+def ioboard_write_command(addr,data):
+  """Return an EngineCommand to write one IO board register via i2c."""
+  addr = addr & 0xff
+  data = data & 0xff
+  return EngineCommand(0x3d, bytes([0x06,0x1d,addr,data]),
+    lambda r: r.response_data & 0xFFFFFF == 0x1d << 16 | addr << 8 | data)
+
+def ioboard_read_command(addr):
+  """Return an EngineCommand to read four IO board registers via i2c."""
+  return EngineCommand(0x3d, bytes([0x07,0x1d,addr & 0xff,0x00]))
+
+def ioboard_read_bytes(res):
+  """Return the four registers in a read response, register addr first."""
+  r = res.response_data
+  return bytes((r & 0xFF, r >> 8 & 0xFF, r >> 16 & 0xFF, r >> 24 & 0xFF))
+
+class CommandEngine:
+  """Send commands to the HL2 with up to "window" commands outstanding, and match the responses.
+  The HL2 answers in order, so a response belongs to the oldest outstanding command that accepts it.
+  The HL2 makes one I2C transfer at a time, so a command has "timeout" seconds from the time it is sent or
+  the command ahead of it is answered, whichever is later.
+  A command without a check, such as an i2c read, is sent alone because a lost response would give it the
+  wrong response. When a command has no response before its deadline, the engine waits until no response
+  has arrived for "timeout" seconds and throws away any late responses. Then it sends that command and all
+  the commands after it again, one at a time and in their order, so the writes are made in order. A command
+  is sent up to "attempts" times, and then the commands after it are not sent."""
+  def __init__(self,hl,window=4,timeout=0.5,attempts=3):
+    self.hl = hl
+    self.window = window
+    self.timeout = timeout
+    self.attempts = attempts
+    self.retries = 0		# number of commands sent again
+    self.unmatched = 0		# number of responses that did not match a command
+  def drain(self,quiet=0.0):
+    """Throw away responses until none arrives for quiet seconds."""
+    sock = self.hl.sock
+    ready = select.select([sock], [], [], quiet)
+    while ready[0]:
+      sock.recvfrom(60)
+      ready = select.select([sock], [], [], quiet)
+  def run(self,commands):
+    """Send the commands and wait for the responses. Return True if all commands have a response."""
+    sock = self.hl.sock
+    commands = list(commands)
+    pending = list(commands)	# commands not sent yet, in order
+    outstanding = []		# commands sent, oldest first
+    window = self.window
+    for c in commands:
+      c.response = None
+    self.drain()		# Throw away old responses
+    while pending or outstanding:
+      while pending and len(outstanding) < window:
+        if outstanding and (pending[0].check is None or outstanding[-1].check is None):
+          break
+        c = pending.pop(0)
+        c.sent += 1
+        c.deadline = time.time() + self.timeout
+        sock.sendto(c.msg, (self.hl.ip,self.hl.port))
+        outstanding.append(c)
+      now = time.time()
+      if outstanding and outstanding[0].deadline <= now:
+        # The oldest command is late. Its response may still come, so wait until the HL2 is quiet.
+        late = outstanding[0]
+        self.drain(self.timeout)
+        if late.sent >= self.attempts:	# give up
+          return False
+        self.retries += 1
+        pending = commands[commands.index(late):]
+        for c in pending:
+          c.response = None
+        outstanding = []
+        window = 1
+        continue
+      if not outstanding:
+        continue
+      ready = select.select([sock], [], [], max(0.0, outstanding[0].deadline - now))
+      if not ready[0]:
+        continue
+      data, ip_port = sock.recvfrom(60)
+      r = decode(data)
+      if ip_port != (self.hl.ip,self.hl.port) or not r:
+        continue
+      for c in outstanding:
+        if c.check is None or c.check(r):
+          c.response = r
+          self.hl.wrcache[c.addr] = c.cmd
+          oldest = c is outstanding[0]
+          outstanding.remove(c)
+          if oldest and outstanding:	# the next command starts its timeout now
+            outstanding[0].deadline = max(outstanding[0].deadline, time.time() + self.timeout)
+          break
+      else:
+        self.unmatched += 1
+    return all(c.response for c in commands)
+
 class HermesLite:
   # Hermes-Lite object
-  def __init__(self,ip_port):
+  def __init__(self,ip_port,ioboard_usb=False):
     self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
     self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
     self.sock.setblocking(0)
     self.ip = ip_port[0]
     self.port = ip_port[1]
     self.wrcache = {}
+    self.engine = CommandEngine(self)
+    self.ioboard_usb = None
+    self.recorder = None	# a traffic.CaptureWriter to record the IO board reads and writes
+    if ioboard_usb:
+      self.open_ioboard_usb()
+
+  def open_ioboard_usb(self,port=None):
+    """Use the IO board USB port for IO board registers if a cable to the IO board of this HL2 is present.
+    Each port, or all the Pico ports if port is None, is checked with confirm_ioboard_usb(). Return True if it is used."""
+    if serial is None:
+      return False
+    self.ioboard_usb = None
+    for name in ([port] if port else find_ioboard_usb()):
+      try:
+        usb = IoBoardUSB(name)
+      except (serial.SerialException, OSError, ValueError):
+        continue
+      if self.confirm_ioboard_usb(usb):
+        self.ioboard_usb = usb
+        return True
+      usb.close()
+    return False
+
+  def confirm_ioboard_usb(self,usb):
+    """Return True if the IoBoardUSB usb is the IO board of this HL2. Two values are written to REG_BANK_PAGE
+    with I2C and read back with USB, and then the register is restored. The page has no effect while REG_BANK
+    is zero, so the USB port is not confirmed while another program is reading a bank."""
+    saved, self.ioboard_usb = self.ioboard_usb, None	# use I2C here
+    try:
+      regs = self.read_ioboard_block(REG_BANK, 2)
+      if regs is None or regs[0] != 0:
+        return False
+      try:
+        for value in ((regs[1] + 0x5A) & 0xFF, (regs[1] + 0xA5) & 0xFF):
+          if not self.write_ioboard_block(REG_BANK_PAGE, (value,)) or usb.read(REG_BANK_PAGE, 1) != bytes((value,)):
+            return False
+      except (IOError, OSError):
+        return False
+      finally:
+        self.write_ioboard_block(REG_BANK_PAGE, (regs[1],))
+      return True
+    finally:
+      self.ioboard_usb = saved
+
+  def _ioboard_usb_failed(self):
+    """The USB cable was removed or the port failed, so use I2C."""
+    print("IO board USB failed, using I2C")
+    try:
+      self.ioboard_usb.close()
+    except Exception:
+      pass
+    self.ioboard_usb = None
 
   def _send(self,msg,port=None,timeout=2.0,attempts=3):
     """Low level send to HL2."""
@@ -618,36 +939,111 @@ class HermesLite:
     return res
 
   def write_ioboard(self,addr,data):
-    """Write to N2ADR IO board Pico via i2c."""
-    time.sleep(0.002)
+    """Write to N2ADR IO board Pico via USB if present, else via i2c."""
     data = data & 0x0ff
     addr = addr & 0x0ff
-    cmd = bytes([0x06,0x1d,addr,data])
-    res = self.command(0x3d,cmd)
-    #print ("0x%08X" % res.response_data)
-    if res and res.response_data & 0xFFFFFF == 0x1d << 16 | addr << 8 | data:
+    if self.write_ioboard_block(addr, (data,)):
       return "Set address %d to %d" % (addr, data)
     return "Failure at address %d in write_ioboard()" % addr
 
   def read_ioboard(self,addr,fullresponse=False):
-    """Read from N2ADR IO board Pico via i2c."""
-    time.sleep(0.002)
+    """Read from N2ADR IO board Pico via USB if present, else via i2c.
+      Returns four registers, the register at addr last."""
     addr = addr & 0xff
-    cmd = bytes([0x07,0x1d,addr,0x00])
-    res = self.command(0x3d,cmd)
+    if self.ioboard_usb and not fullresponse:
+      try:
+        data = self.ioboard_usb.read(addr, 4)
+        if self.recorder:
+          self.recorder.host_read(addr, data)
+        return tuple(reversed(data))
+      except (IOError, OSError):
+        self._ioboard_usb_failed()
+    c = ioboard_read_command(addr)
+    self.engine.run((c,))
+    res = c.response
     #print ("0x%08X" % res.response_data)
+    if res and self.recorder:
+      self.recorder.host_read(addr, ioboard_read_bytes(res))
     if fullresponse:
       return res
     elif res:
       r = res.response_data
       return (r >> 24 & 0xFF, r >> 16 & 0xFF, r >> 8 & 0xFF, r & 0xFF)
 
+  def write_ioboard_block(self,addr,data):
+    """Write the bytes in data to IO board registers addr, addr + 1, ... Return True for success."""
+    ok = False
+    if self.ioboard_usb:
+      try:
+        self.ioboard_usb.write(addr, bytes(data))
+        ok = True
+      except (IOError, OSError):
+        self._ioboard_usb_failed()
+    if not ok:
+      ok = self.engine.run([ioboard_write_command(addr + i, data[i]) for i in range(len(data))])
+    if ok and self.recorder:
+      self.recorder.host_write(addr, data)
+    return ok
+
+  def read_ioboard_block(self,addr,count):
+    """Read count IO board registers starting at addr. Return bytes, or None for failure."""
+    data = None
+    if self.ioboard_usb:
+      try:
+        data = self.ioboard_usb.read(addr, count)
+      except (IOError, OSError):
+        self._ioboard_usb_failed()
+    if data is None:
+      commands = [ioboard_read_command(addr + i) for i in range(0, count, 4)]
+      if not self.engine.run(commands):
+        return None
+      data = b''.join(ioboard_read_bytes(c.response) for c in commands)[0:count]
+    if self.recorder:
+      self.recorder.host_read(addr, data)
+    return data
+
+  def read_ioboard_bank(self,bank):
+    """Read all of an IO board register bank, such as bank 1 for the trace. Return bytes, or None for failure."""
+    if not self.write_ioboard_block(REG_BANK, (bank,)):
+      return None
+    pages = self.read_ioboard_block(REG_BANK_PAGES, 1)
+    data = None
+    if pages and self.ioboard_usb:
+      data = self._read_ioboard_bank_usb(pages[0])
+    if pages and data is None:
+      data = b''
+      for page in range(pages[0]):
+        self.write_ioboard_block(REG_BANK_PAGE, (page,))
+        block = self.read_ioboard_block(REG_BANK_WINDOW, BANK_WINDOW_SIZE)
+        if block is None:
+          data = None
+          break
+        data += block
+    self.write_ioboard_block(REG_BANK, (0,))
+    return data
+
+  def _read_ioboard_bank_usb(self,pages):
+    """Read the pages of the selected bank with several pages in each USB command."""
+    per_command = USB_MAX_READ // BANK_WINDOW_SIZE
+    data = b''
+    for first in range(0, pages, per_command):
+      ops = []
+      for page in range(first, min(pages, first + per_command)):
+        ops.append(('w', REG_BANK_PAGE, (page,)))	# select the page, then read the window
+        ops.append(('r', REG_BANK_WINDOW, BANK_WINDOW_SIZE))
+      try:
+        data += self.ioboard_usb.transaction(ops)
+      except (IOError, OSError):
+        self._ioboard_usb_failed()
+        return None
+    return data
+
   def read_ioboard_rom(self,fullresponse=False):
     """Read from N2ADR IO board ROM via i2c."""
-    time.sleep(0.002)
     addr = 0x00
-    cmd = bytes([0x07,0x41,addr,0x00])
-    res = self.command(0x3d,cmd)
+    c = EngineCommand(0x3d, bytes([0x07,0x41,addr,0x00]))
+    self.engine.run((c,))
+    res = c.response
     #print ("0x%08X" % res.response_data)
     if fullresponse:
       return res
@@ -656,24 +1052,261 @@ class HermesLite:
 
   def set_ioboard_freq(self, hertz):
     """Send the frequency in hertz to the IO board"""
-    ret = self.write_ioboard(0, hertz >> 32 & 0xFF)
-    if ret[0:8] == "Failure ":
-      return ret
-    ret = self.write_ioboard(1, hertz >> 24 & 0xFF)
-    if ret[0:8] == "Failure ":
-      return ret
-    ret = self.write_ioboard(2, hertz >> 16 & 0xFF)
-    if ret[0:8] == "Failure ":
-      return ret
-    ret = self.write_ioboard(3, hertz >>  8 & 0xFF)
-    if ret[0:8] == "Failure ":
-      return ret
+    # The firmware uses the new frequency when register 4 is written, so write it after the others.
+    data = (hertz >> 32 & 0xFF, hertz >> 24 & 0xFF, hertz >> 16 & 0xFF, hertz >> 8 & 0xFF)
+    if not self.write_ioboard_block(0, data):
+      return "Failure at address 0 in set_ioboard_freq()"
     ret = self.write_ioboard(4, hertz & 0xFF)
     if ret[0:8] == "Failure ":
       return ret
     return hertz
 
 
+## Registers that start an action when written. A write to these is never suppressed, and the value is not kept.
+## Register 4 latches the Tx frequency, 8 clears a fault and 97 sets the band voltage.
+MIRROR_COMMAND_REGISTERS = frozenset((4, 5, 8, 33, 34, 40, 47, 68, 87, 97, 99, 104, 112) + tuple(range(128, 160)))
+## Registers whose values are never kept: the bank window, and registers set by the firmware when read,
+## the ADC 25 to 30, the meter 48 to 57, the filter 80 to 85, the trace 105 and 106 and the changes 116 to 119.
+MIRROR_UNCACHED = frozenset(tuple(range(25, 31)) + tuple(range(48, 58)) + tuple(range(80, 86)) +
+  (105, 106, 116, 117, 118, 119) + tuple(range(128, 160)))
+REG_CONTROL = 5
+REG_CHANGE_SEQ_MSB = 116
+
+class RegisterMirror:
+  """A host copy of the IO board registers shared by the GUI and scripts.
+  A register is known after it is read or written, and it becomes unknown when the firmware change counter
+  says its block of sixteen registers changed, or when it is older than max_age seconds. Reads of known registers
+  and writes of an unchanged value to a known register do not go to the IO board. Reads of unknown registers
+  are made as aligned four-byte HL2 reads, or as one USB read. Call refresh_changes() before each poll."""
+  def __init__(self,hl,max_age=2.0):
+    self.hl = hl
+    self.max_age = max_age
+    self.values = bytearray(256)
+    self.read_time = [0.0] * 256	# time the register was read or written, 0.0 if unknown
+    self.change_seq = None		# last value of the firmware change counter, 0 if not supported
+    self.changed = 0xFFFF		# bit n is set if block n changed at the last refresh_changes()
+    self.last_response = None		# the last HL2 response to a read
+    self.reads = 0			# number of HL2 or USB reads
+    self.writes = 0			# number of HL2 or USB writes
+    self.suppressed = 0			# number of writes not needed
+    self.lock = threading.RLock()
+  def invalidate(self,addr=0,count=256):
+    """Make registers unknown."""
+    with self.lock:
+      for a in range(addr, min(addr + count, 256)):
+        self.read_time[a] = 0.0
+  def is_known(self,addr,now=None):
+    """Return True if the register value is known."""
+    if now is None:
+      now = time.time()
+    return now - self.read_time[addr] < self.max_age
+  def refresh_changes(self):
+    """Read the firmware change counter and make the changed blocks unknown. Return False for failure.
+    The changed blocks are in self.changed."""
+    with self.lock:
+      self.changed = 0xFFFF
+      data = self._read_span(REG_CHANGE_SEQ_MSB, 4)
+      if data is None:
+        self.invalidate()
+        return False
+      seq = data[0] << 8 | data[1]
+      if seq == 0:		# firmware without change tracking
+        self.invalidate()
+      elif seq != self.change_seq:
+        # The counter counts the reads that took changes. It skips zero, so it has 65535 values.
+        # If it went up by more than one, another program took some of the changes, so all blocks are unknown.
+        if self.change_seq is not None and (seq - self.change_seq) % 0xFFFF == 1:
+          self.changed = data[2] << 8 | data[3]
+        for block in range(16):
+          if self.changed & (1 << block):
+            self.invalidate(block * 16, 16)
+      else:
+        self.changed = 0
+      self.change_seq = seq
+      return True
+  def read(self,addr,count=1,force=False):
+    """Return count register values starting at addr as bytes, or None for failure. Only unknown registers are read."""
+    addr &= 0xFF
+    count = min(count, 256 - addr)
+    with self.lock:
+      now = time.time()
+      need = [a for a in range(addr, addr + count) if force or not self.is_known(a, now)]
+      if need:
+        if self.hl.ioboard_usb:
+          if self._read_span(need[0], need[-1] + 1 - need[0]) is None:
+            return None
+        else:
+          groups = sorted(set(a & ~3 for a in need))
+          commands = [ioboard_read_command(g) for g in groups]
+          self.hl.engine.run(commands)
+          self.reads += len(commands)
+          for g, c in zip(groups, commands):
+            if not c.response:
+              return None
+            self.last_response = c.response
+            self._store(g, ioboard_read_bytes(c.response), time.time())
+            if self.hl.recorder:
+              self.hl.recorder.host_read(g, ioboard_read_bytes(c.response))
+      return bytes(self.values[addr:addr + count])
+  def write(self,addr,data,force=False):
+    """Write an int or bytes to the registers starting at addr. Return True for success.
+    Writes of the known value are suppressed unless force is True."""
+    if isinstance(data, int):
+      data = (data,)
+    addr &= 0xFF
+    data = bytes(data)[0:256 - addr]
+    with self.lock:
+      now = time.time()
+      start = None
+      for i in range(len(data) + 1):
+        a = addr + i
+        need = i < len(data) and (force or a in MIRROR_COMMAND_REGISTERS or
+          not self.is_known(a, now) or self.values[a] != data[i])
+        if need:
+          if start is None:
+            start = i
+          continue
+        if start is not None:	# write registers start to i - 1 in one block
+          self.writes += 1
+          if not self.hl.write_ioboard_block(addr + start, data[start:i]):
+            self.invalidate(addr + start, i - start)
+            return False
+          self._store(addr + start, data[start:i], time.time(), True)
+          start = None
+        if i < len(data):
+          self.suppressed += 1
+      if REG_CONTROL in range(addr, addr + len(data)):	# a reset may change all registers
+        self.invalidate()
+      return True
+  def _read_span(self,addr,count):
+    """Read registers from the IO board and store them."""
+    self.reads += 1
+    data = self.hl.read_ioboard_block(addr, count)
+    if data is not None:
+      self._store(addr, data, time.time())
+    return data
+  def _store(self,addr,data,now,written=False):
+    for i in range(len(data)):
+      a = addr + i
+      if a < 256:
+        self.values[a] = data[i]
+        if a in MIRROR_UNCACHED or (written and a in MIRROR_COMMAND_REGISTERS):
+          self.read_time[a] = 0.0
+        else:
+          self.read_time[a] = now
+
+
+## The local socket of hl2_daemon.py
+DAEMON_SOCKET = os.path.join(tempfile.gettempdir(), 'hl2_daemon.sock')
+DAEMON_PORT = 28025	# TCP port on 127.0.0.1 if there are no Unix sockets
+
+DaemonStatus = collections.namedtuple('DaemonStatus', 'ip port temperature')
+
+class DaemonClient:
+  """Share the IO board registers of one HL2 with other programs through hl2_daemon.py.
+  This has the methods of RegisterMirror, and the response() and read_ioboard_rom() methods of HermesLite."""
+  def __init__(self,sock,timeout=2.0):
+    self.sock = sock
+    self.timeout = timeout
+    self.buffer = b''
+    self.id = 0
+    self.values = bytearray(256)
+    self.last_response = None	# a DaemonStatus with the last temperature
+    self.changed = 0		# blocks changed since the last call to changes()
+    self.lock = threading.RLock()
+    self.ip = self.port = None
+  @staticmethod
+  def connect():
+    """Return a DaemonClient if the daemon is running, else None."""
+    try:
+      if hasattr(socket, 'AF_UNIX'):
+        if not os.path.exists(DAEMON_SOCKET):
+          return None
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        sock.connect(DAEMON_SOCKET)
+      else:
+        sock = socket.create_connection(('127.0.0.1', DAEMON_PORT), timeout=0.5)
+    except OSError:
+      return None
+    return DaemonClient(sock)
+  def close(self):
+    self.sock.close()
+  def _request(self,op,**args):
+    """Send a request and return the reply, or None if the daemon is gone."""
+    with self.lock:
+      self.id += 1
+      args.update(id=self.id, op=op)
+      try:
+        self.sock.sendall(json.dumps(args).encode('utf-8') + b'\n')
+        end = time.time() + self.timeout
+        while True:
+          while b'\n' in self.buffer:
+            line, self.buffer = self.buffer.split(b'\n', 1)
+            msg = json.loads(line)
+            if msg.get('event') == 'changed':
+              self.changed |= msg['blocks']
+            elif msg.get('id') == self.id:
+              return msg
+          wait = end - time.time()
+          if wait <= 0 or not select.select([self.sock], [], [], wait)[0]:
+            return None
+          data = self.sock.recv(65536)
+          if not data:
+            return None
+          self.buffer += data
+      except OSError:
+        return None
+  def response(self):
+    """Return a DaemonStatus with the HL2 temperature, or None if there is no HL2."""
+    reply = self._request('status')
+    if not reply or 'error' in reply:
+      return None
+    self.ip = reply['ip']
+    self.port = reply['port']
+    self.last_response = DaemonStatus(reply['ip'], reply['port'], reply['temperature'] or 0.0)
+    return self.last_response
+  def read_ioboard_rom(self):
+    reply = self._request('rom')
+    if reply:
+      return reply.get('data')
+  def refresh_changes(self):
+    """The daemon reads the change counter, so this does nothing."""
+    return True
+  def read(self,addr,count=1,force=False):
+    """Return count register values starting at addr as bytes, or None for failure."""
+    reply = self._request('read', addr=addr, count=count, force=force)
+    if not reply or 'data' not in reply:
+      return None
+    data = bytes(reply['data'])
+    self.values[addr:addr + len(data)] = data
+    if reply.get('temperature') is not None:
+      self.last_response = DaemonStatus(self.ip, self.port, reply['temperature'])
+    return data
+  def write(self,addr,data,force=False):
+    """Write an int or bytes to the registers starting at addr. Return True for success."""
+    if isinstance(data, int):
+      data = (data,)
+    reply = self._request('write', addr=addr, data=list(data), force=force)
+    return bool(reply and reply.get('ok'))
+  def subscribe(self,blocks=0xFFFF):
+    """Ask for change notices for the blocks of sixteen registers in the bitmap."""
+    return bool(self._request('subscribe', blocks=blocks))
+  def changes(self):
+    """Return the bitmap of subscribed blocks that changed since the last call."""
+    with self.lock:
+      if select.select([self.sock], [], [], 0)[0]:
+        data = self.sock.recv(65536)
+        self.buffer += data
+        for line in self.buffer.split(b'\n')[:-1]:
+          msg = json.loads(line)
+          if msg.get('event') == 'changed':
+            self.changed |= msg['blocks']
+        self.buffer = self.buffer[self.buffer.rfind(b'\n') + 1:]
+      changed = self.changed
+      self.changed = 0
+      return changed
+
+
 if __name__ == "__main__":
   hl = discover_first()
   ##hl = HermesLite( ("10.10.0.180",1025) ) # Connect to specific IP
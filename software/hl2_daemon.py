@@ -0,0 +1,179 @@
+#!/usr/bin/env python
+
+# This daemon owns the connection to one Hermes Lite 2 and shares the IO board registers with several programs.
+# Programs connect to a local socket, a Unix socket or TCP port 127.0.0.1:DAEMON_PORT on Windows, and send one
+# JSON request per line. All HL2 traffic goes through one command engine and one register mirror, so two
+# programs never lose each other's responses, and a register read by several programs is read from the HL2
+# once for each change. The daemon reads the firmware change counter at most once each poll period.
+#
+# Requests are {"id": n, "op": name, ...} and each reply has the same id:
+#   read:      "addr", "count", optional "force"    reply "data", a list of values, and "temperature"
+#   write:     "addr", "data" a list of values, optional "force"    reply "ok"
+#   rom:       read the IO board ROM    reply "data"
+#   status:    reply "ip", "port" and "temperature", or "error" if there is no HL2
+#   subscribe: "blocks", a bitmap of the 16-register blocks to watch
+# A failed request has "error" in the reply. A subscribed program gets {"event": "changed", "blocks": bitmap}
+# when the change counter shows that watched blocks changed. The class hermeslite.DaemonClient is a client.
+#
+# To run the daemon: python hl2_daemon.py [HL2 IP address] [--capture file.hl2cap]
+# With --capture, the IO board reads and writes are recorded in the file. See traffic.py.
+
+import sys, os, socket, select, json, time, traceback
+import hermeslite, traffic
+
+POLL_PERIOD = 0.1	# seconds between reads of the change counter
+SEARCH_PERIOD = 2.0	# seconds between searches for the HL2
+KEEPALIVE_PERIOD = 5.0	# seconds between HL2 status requests
+
+class Client:
+  def __init__(self, sock):
+    self.sock = sock
+    self.buffer = b''
+    self.blocks = 0		# subscribed blocks
+  def send(self, msg):
+    self.sock.sendall(json.dumps(msg).encode('utf-8') + b'\n')
+
+class Daemon:
+  def __init__(self, ip=None, recorder=None):
+    self.ip = ip
+    self.recorder = recorder	# a traffic.CaptureWriter or None
+    self.hl = None
+    self.mirror = None
+    self.temperature = None
+    self.clients = []
+    self.search_time = 0
+    self.keepalive_time = 0
+    self.refresh_time = 0
+  def listen(self):
+    """Return the listening socket."""
+    if hasattr(socket, 'AF_UNIX'):
+      path = hermeslite.DAEMON_SOCKET
+      if os.path.exists(path):
+        os.unlink(path)
+      sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+      sock.bind(path)
+    else:
+      sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+      sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+      sock.bind(('127.0.0.1', hermeslite.DAEMON_PORT))
+    sock.listen(8)
+    return sock
+  def run(self):
+    listener = self.listen()
+    while True:
+      socks = [listener] + [c.sock for c in self.clients]
+      ready = select.select(socks, [], [], POLL_PERIOD)
+      for sock in ready[0]:
+        if sock is listener:
+          conn, address = listener.accept()
+          self.clients.append(Client(conn))
+        else:
+          self.Receive([c for c in self.clients if c.sock is sock][0])
+      try:
+        self.Poll()
+      except Exception:
+        traceback.print_exc()
+  def Receive(self, client):
+    try:
+      data = client.sock.recv(65536)
+    except OSError:
+      data = b''
+    if not data:
+      self.clients.remove(client)
+      client.sock.close()
+      return
+    client.buffer += data
+    while b'\n' in client.buffer:
+      line, client.buffer = client.buffer.split(b'\n', 1)
+      try:
+        request = json.loads(line)
+        reply = self.Request(client, request)
+      except Exception as error:
+        reply = {'id': None, 'error': str(error)}
+      try:
+        client.send(reply)
+      except OSError:
+        pass
+  def Request(self, client, request):
+    op = request.get('op')
+    reply = {'id': request.get('id')}
+    if op == 'subscribe':
+      client.blocks = int(request.get('blocks', 0xFFFF))
+      reply['ok'] = True
+      return reply
+    if not self.hl:
+      reply['error'] = 'No HL2'
+      return reply
+    if op == 'status':
+      reply.update(ip=self.hl.ip, port=self.hl.port, temperature=self.temperature)
+    elif op == 'read':
+      self.Refresh()
+      data = self.mirror.read(int(request['addr']), int(request.get('count', 1)), bool(request.get('force', False)))
+      if data is None:
+        reply['error'] = 'Read failed'
+      else:
+        reply['data'] = list(data)
+        if self.mirror.last_response:
+          self.temperature = self.mirror.last_response.temperature
+        reply['temperature'] = self.temperature
+    elif op == 'write':
+      reply['ok'] = self.mirror.write(int(request['addr']), bytes(request['data']), bool(request.get('force', False)))
+    elif op == 'rom':
+      reply['data'] = self.hl.read_ioboard_rom()
+    else:
+      reply['error'] = 'Unknown op %s' % op
+    return reply
+  def Refresh(self):
+    """Read the change counter if it was not read in this poll period, and tell the subscribers."""
+    if time.time() - self.refresh_time < POLL_PERIOD:
+      return
+    self.refresh_time = time.time()
+    self.mirror.refresh_changes()
+    changed = self.mirror.changed
+    for client in list(self.clients):
+      if client.blocks & changed:
+        try:
+          client.send({'event': 'changed', 'blocks': client.blocks & changed})
+        except OSError:
+          pass
+  def Poll(self):
+    now = time.time()
+    if not self.hl:
+      if now - self.search_time > SEARCH_PERIOD:
+        self.search_time = now
+        self.hl = hermeslite.discover_first(0, ip=self.ip, ports=(1025,))
+        if self.hl:
+          print("Using HL2 at %s:%d" % (self.hl.ip, self.hl.port))
+          if self.hl.open_ioboard_usb():	# a USB cable to this IO board
+            print("Using the IO board USB port")
+          self.hl.recorder = self.recorder
+          self.mirror = hermeslite.RegisterMirror(self.hl)
+          self.keepalive_time = 0
+      return
+    if now - self.keepalive_time > KEEPALIVE_PERIOD:
+      self.keepalive_time = now
+      resp = self.hl.response()
+      if not resp:
+        print("Lost the HL2")
+        self.hl = self.mirror = None
+        self.temperature = None
+        return
+      self.temperature = resp.temperature
+    if any(c.blocks for c in self.clients):
+      self.Refresh()
+
+
+if __name__ == "__main__":
+  args = sys.argv[1:]
+  recorder = None
+  if '--capture' in args:
+    i = args.index('--capture')
+    recorder = traffic.CaptureWriter(args[i + 1])
+    del args[i:i + 2]
+  ip = args[0] if args else None
+  try:
+    Daemon(ip, recorder).run()
+  except KeyboardInterrupt:
+    pass
+  if recorder:
+    recorder.close()
@@ -0,0 +1,203 @@
+#!/usr/bin/env python
+
+# This emulates a Hermes Lite 2 with an IO board, so the IO board software can be tested and timed with no radio.
+# It answers the HL2 discover and command packets on UDP port 1025 as hermeslite.py uses them. I2C commands
+# (address 0x3d) to the IO board at 0x1D go to the IO board firmware built for the host computer, and a read of
+# the IO board ROM at 0x41 returns 0xF1. Other commands are answered and ignored. Build the firmware first:
+#   cmake -S host -B host/build -DFIRMWARE=n2adr_basic && cmake --build host/build
+# and then run the emulator and use 127.0.0.1 as the HL2 IP address:
+#   python hl2_emulator.py [--latency ms] [--jitter ms] [--loss fraction] [--flash file] [--lib path]
+# Without the firmware library the IO board is a plain array of 256 registers.
+#
+# The HL2 makes one I2C transfer at a time. In the emulator each transfer takes the latency plus a random jitter,
+# and a command that arrives while the bus is busy waits for it. The firmware sees the transfer at the end of that
+# time, and the response is sent then. With --loss, that fraction of the responses is thrown away.
+
+import sys, os, socket, struct, time, random, threading, ctypes, argparse
+try:
+  import queue
+except ImportError:
+  import Queue as queue
+
+IOBOARD_ADDRESS = 0x1D
+ROM_ADDRESS = 0x41
+ROM_VALUE = 0xF1
+GPIO13_EXTTR = 13
+FLASH_SIZE = 2 * 1024 * 1024
+EMULATOR_MAC = bytes((0x00, 0x1c, 0xc0, 0xa2, 0xe0, 0x01))
+GATEWARE = (73, 2)
+HL2_TEMPERATURE = 1068		# the HL2 temperature ADC value for about 35 C
+
+def default_library():
+  """Return the path of the firmware library built in host/build."""
+  name = 'libhl2io_host.dylib' if sys.platform == 'darwin' else 'libhl2io_host.so'
+  return os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'host', 'build', name)
+
+class PlainIoBoard:
+  """An IO board that is only 256 registers, for use without the firmware library."""
+  def __init__(self):
+    self.registers = bytearray(256)
+  def start(self):
+    pass
+  def i2c_write(self, address, data):
+    if address != IOBOARD_ADDRESS:
+      return False
+    for i, value in enumerate(data[1:]):
+      self.registers[(data[0] + i) & 0xFF] = value
+    return True
+  def i2c_read(self, address, reg, count):
+    if address != IOBOARD_ADDRESS:
+      return None
+    return bytes(self.registers[(reg + i) & 0xFF] for i in range(count))
+  def set_input(self, gpio, value):
+    pass
+
+class FirmwareIoBoard:
+  """The IO board firmware built for the host computer. See host/pico_host.c for the functions."""
+  def __init__(self, path, flash_file=None):
+    self.lib = lib = ctypes.CDLL(path)
+    lib.host_i2c_write.argtypes = (ctypes.c_uint8, ctypes.c_char_p, ctypes.c_int)
+    lib.host_i2c_read.argtypes = (ctypes.c_uint8, ctypes.c_uint8, ctypes.c_char_p, ctypes.c_int)
+    lib.host_gpio_set_input.argtypes = (ctypes.c_uint, ctypes.c_bool)
+    lib.host_gpio_get_all.restype = ctypes.c_uint32
+    lib.host_adc_set.argtypes = (ctypes.c_uint, ctypes.c_uint16)
+    lib.host_usb_write.argtypes = (ctypes.c_char_p, ctypes.c_int)
+    lib.host_usb_read.argtypes = (ctypes.c_char_p, ctypes.c_int)
+    lib.host_i2c_ready.restype = ctypes.c_bool
+    lib.host_time_us.restype = ctypes.c_uint64
+    self.flash = (ctypes.c_uint8 * FLASH_SIZE).in_dll(lib, 'host_flash')
+    self.flash_file = flash_file
+    if flash_file and os.path.exists(flash_file):
+      with open(flash_file, 'rb') as fp:
+        data = fp.read(FLASH_SIZE)
+      ctypes.memmove(self.flash, data, len(data))
+  def start(self):
+    """Start the firmware with EXTTR high for receive, and wait for it to set up I2C."""
+    self.set_input(GPIO13_EXTTR, 1)
+    self.lib.host_start()
+    end = time.time() + 2.0
+    while not self.lib.host_i2c_ready() and time.time() < end:
+      time.sleep(0.01)
+  def save_flash(self):
+    if self.flash_file:
+      with open(self.flash_file, 'wb') as fp:
+        fp.write(bytes(self.flash))
+  def i2c_write(self, address, data):
+    data = bytes(data)
+    return self.lib.host_i2c_write(address, data, len(data)) >= 0
+  def i2c_read(self, address, reg, count):
+    buf = ctypes.create_string_buffer(count)
+    if self.lib.host_i2c_read(address, reg, buf, count) < 0:
+      return None
+    return buf.raw
+  def set_input(self, gpio, value):
+    self.lib.host_gpio_set_input(gpio, bool(value))
+  def get_pins(self):
+    return self.lib.host_gpio_get_all()
+  def set_adc(self, channel, value):
+    self.lib.host_adc_set(channel, value)
+  def usb_write(self, data):
+    data = bytes(data)
+    return self.lib.host_usb_write(data, len(data))
+  def usb_read(self, count=4096):
+    buf = ctypes.create_string_buffer(count)
+    n = self.lib.host_usb_read(buf, count)
+    return buf.raw[0:n]
+  def time_us(self):
+    return self.lib.host_time_us()
+
+class HL2Emulator:
+  """Answer HL2 packets on a UDP port. The I2C commands go to the ioboard, a PlainIoBoard or FirmwareIoBoard."""
+  def __init__(self, ioboard, host='0.0.0.0', port=1025, latency=0.0005, jitter=0.0001, loss=0.0):
+    self.ioboard = ioboard
+    self.latency = latency
+    self.jitter = jitter
+    self.loss = loss
+    self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    self.sock.bind((host, port))
+    self.bus = queue.Queue()	# commands waiting for the I2C bus
+    self.bus_free = 0.0		# time when the bus is free
+    self.commands = 0
+    self.dropped = 0
+  def response(self, response_data=0):
+    """Return a 60-byte HL2 response."""
+    r = bytearray(60)
+    r[0:3] = b'\xef\xfe\x02'
+    r[3:9] = EMULATOR_MAC
+    r[0x09] = GATEWARE[0]
+    r[0x0a] = 6			# radio ID of the HL2
+    r[0x13] = 4			# receivers
+    r[0x14] = 5			# board ID
+    r[0x15] = GATEWARE[1]
+    r[0x17:0x1b] = struct.pack('!L', response_data)
+    r[0x1c:0x1e] = struct.pack('!H', HL2_TEMPERATURE)
+    return bytes(r)
+  def run(self):
+    """Receive and answer packets until stopped."""
+    threading.Thread(target=self.bus_thread, daemon=True).start()
+    while True:
+      data, address = self.sock.recvfrom(1500)
+      if len(data) < 3 or data[0:2] != b'\xef\xfe':
+        continue
+      if data[2] == 0x02:		# discover
+        self.sock.sendto(self.response(), address)
+      elif data[2] == 0x05 and len(data) >= 9:	# command
+        now = time.time()
+        self.bus_free = max(now, self.bus_free) + self.latency + random.uniform(0, self.jitter)
+        self.bus.put((self.bus_free, data, address))
+  def bus_thread(self):
+    while True:
+      done, data, address = self.bus.get()
+      wait = done - time.time()
+      if wait > 0:
+        time.sleep(wait)
+      response_data = self.command(data[4] >> 1, data[5:9])
+      self.commands += 1
+      if self.loss and random.random() < self.loss:
+        self.dropped += 1
+        continue
+      self.sock.sendto(self.response(response_data), address)
+  def command(self, addr, cmd):
+    """Perform one command and return the response data."""
+    if addr != 0x3d:
+      return 0
+    op, i2c_address, reg, value = cmd[0], cmd[1], cmd[2], cmd[3]
+    if op == 0x06:		# write one byte; the response echoes the command
+      self.ioboard.i2c_write(i2c_address, (reg, value))
+      return i2c_address << 16 | reg << 8 | value
+    if op == 0x07:		# read four bytes, the first in the low byte
+      if i2c_address == ROM_ADDRESS:
+        return ROM_VALUE
+      data = self.ioboard.i2c_read(i2c_address, reg, 4)
+      if data is None:
+        return 0
+      return struct.unpack('<L', data)[0]
+    return 0
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description="Emulate an HL2 with an IO board on a UDP port")
+  parser.add_argument('--lib', default=default_library(), help="the firmware library built in host/")
+  parser.add_argument('--port', type=int, default=1025)
+  parser.add_argument('--latency', type=float, default=0.5, help="milliseconds for each I2C transfer")
+  parser.add_argument('--jitter', type=float, default=0.1, help="maximum random milliseconds added")
+  parser.add_argument('--loss', type=float, default=0.0, help="fraction of responses thrown away")
+  parser.add_argument('--flash', help="file to keep the flash memory in")
+  args = parser.parse_args()
+  if os.path.exists(args.lib):
+    ioboard = FirmwareIoBoard(args.lib, args.flash)
+    print("Using the firmware in %s" % args.lib)
+  else:
+    ioboard = PlainIoBoard()
+    print("No firmware library %s, using plain registers" % args.lib)
+  ioboard.start()
+  emulator = HL2Emulator(ioboard, port=args.port, latency=args.latency / 1000, jitter=args.jitter / 1000, loss=args.loss)
+  print("HL2 emulator on UDP port %d" % args.port)
+  try:
+    emulator.run()
+  except KeyboardInterrupt:
+    pass
+  if isinstance(ioboard, FirmwareIoBoard):
+    ioboard.save_flash()
+  print("Commands %d, responses dropped %d" % (emulator.commands, emulator.dropped))
@@ -8,10 +8,47 @@ import hermeslite
 
 VERSION = 'Version 1.1'
 
-def no_port_1024_discover(ifaddr=None, verbose=2):
-  return hermeslite.discover_by_port(ifaddr, 1025, verbose)
+REFRESH_MS = 50		# milliseconds between updates of the widgets
 
-hermeslite.discover = no_port_1024_discover
+CHANGE_PERIOD = 0.1	# seconds between reads of the firmware change counter
+
+class PollItem:
+  """Registers shown in the window. The comm thread reads an item every period seconds, highest priority (lowest
+  number) first. While the values do not change the period doubles up to max_period. It goes back to period when
+  the values change, when the firmware reports a change in the item's registers, or when key() changes."""
+  def __init__(self, name, priority, period, max_period, poll, key=None):
+    self.name = name
+    self.priority = priority
+    self.period = period
+    self.max_period = max_period
+    self.poll = poll		# function to read the registers and set the widgets; returns the values or None
+    self.key = key		# function to return the widget setting that selects the registers, or None
+    self.interval = period
+    self.due = 0.0
+    self.values = None
+    self.last_key = None
+    self.blocks = 0		# bitmap of the 16-register blocks read by the last poll
+  def wake(self):
+    self.interval = self.period
+    self.due = 0.0
+  def is_due(self, now):
+    if self.key:
+      key = self.key()
+      if key != self.last_key:
+        self.last_key = key
+        self.wake()
+    return now >= self.due
+  def run(self, now):
+    self.blocks = 0
+    values = self.poll(self)
+    if values is None:		# a failure or nothing to show
+      self.interval = self.period
+    elif values == self.values:
+      self.interval = min(self.interval * 2, self.max_period)
+    else:
+      self.interval = self.period
+    self.values = values
+    self.due = now + self.interval
 
 class CommThread(threading.Thread):
   def __init__(self, app):
@@ -19,29 +56,56 @@ class CommThread(threading.Thread):
     self.app = app
     self.HL = None
     self.have_ioboard = False
-    self.poll_state = 0
     self.comm_time = 0
+    self.change_time = 0
+    self.pins_changed = False	# a GPIO pin was written
     self.useBandVolts = 0
     self.useUartTx = 0
     self.useUartRx = 0
-    self.Registers = bytearray(256)
+    self.mirror = None		# the register mirror for self.HL
     self.write_queue = queue.SimpleQueue()
+    self.queued = 0		# number of writes put on the write queue
+    self.written = 0		# number of writes taken from the write queue
+    # The thread does not use Tk. The application copies the widget settings to self.selection, and the thread
+    # puts a copy of self.state, the values to show, on self.state_queue when it changes. See Application.Refresh().
+    self.selection = {'reg_index':'', 'gpio_index':'', 'var_name1':''}
+    self.state = {}
+    self.published = None
+    self.published_written = 0
+    self.state_queue = queue.SimpleQueue()
+    self.poll_items = [
+      PollItem("pins", 0, 0.1, 1.0, self.PollPins),
+      PollItem("register", 1, 0.2, 2.0, self.PollRegister, lambda: self.selection['reg_index']),
+      PollItem("gpio", 1, 0.2, 2.0, self.PollGpio, lambda: self.selection['gpio_index']),
+      PollItem("variable", 1, 0.2, 1.0, self.PollVariable, lambda: self.selection['var_name1']),
+      PollItem("frequency", 2, 0.5, 2.0, self.PollFrequency),
+      ]
+    self.wakeup = threading.Event()	# set to run the loop at once
+    # The application sets and clears these from the Tk thread, and only this thread changes the poll items.
+    self.visible = threading.Event()	# clear while the window is minimized, so the registers are not read
+    self.visible.set()
+    self.remapped = threading.Event()	# set when the window is shown again, so all items are read at once
     self.doQuit = threading.Event()
     self.doQuit.clear()
   def run(self):
     while not self.doQuit.is_set():
+      wait = 0.1
       try:
         if self.HL:
           self.Purge()
           self.KeepAlive()
           if self.have_ioboard:
-            self.PollIoBoard()
+            wait = self.PollIoBoard()
         else:	# search for the Hermes Lite2
           self.SearchHL2()
-        time.sleep(0.1)
       except:
         traceback.print_exc()
+      self.Publish()
+      self.wakeup.wait(wait)
+      self.wakeup.clear()
   def Purge(self):
+    if not isinstance(self.HL, hermeslite.HermesLite):	# hl2_daemon.py reads the HL2
+      return
     try:
       sock = self.HL.sock
       ready = select.select([sock], [], [], 0)	# Throw away available input
@@ -49,194 +113,243 @@ class CommThread(threading.Thread):
         data, ip_port = sock.recvfrom(60)
     except:
       traceback.print_exc()
+  def Show(self, name, value):
+    """Set the value to show in the application variable or widget name."""
+    self.state[name] = value
+  def Publish(self):
+    if self.state != self.published or self.written != self.published_written:
+      self.published = dict(self.state)
+      self.published_written = self.written
+      self.state_queue.put((self.written, self.published))
   def stop(self):
     self.doQuit.set()
+    self.wakeup.set()
   def SearchHL2(self):
     if time.time() - self.comm_time > 2.0:
       if self.app.known_ip:
-        self.app.IP.set("  Trying...")
-        hl = hermeslite.HermesLite((self.app.known_ip, 1025))
-        if hl.response():
-          self.HL = hl
+        self.Show('IP', "  Trying...")
       else:
-        self.app.IP.set("  Searching...")
-        self.HL = hermeslite.discover_first(0)
+        self.Show('IP', "  Searching...")
+      # Use hl2_daemon.py if it is running so other programs can share the HL2.
+      daemon = hermeslite.DaemonClient.connect()
+      if daemon:
+        if daemon.response():
+          self.HL = daemon
+          daemon.subscribe()	# the daemon tells us which registers changed
+        else:
+          daemon.close()
+      else:	# Search all interfaces at once on port 1025 only. The last radio found answers first.
+        self.HL = hermeslite.discover_first(0, ip=self.app.known_ip, ports=(1025,))
       if self.HL:
-        self.app.IP.set("%s:%d" % (self.HL.ip, self.HL.port))
+        self.Show('IP', "%s:%d" % (self.HL.ip, self.HL.port))
         time.sleep(0.3)
         self.Purge()
         if self.HL.read_ioboard_rom() == 0xF1:
           self.have_ioboard = True
         elif self.HL.read_ioboard_rom() == 0xF1:
           self.have_ioboard = True
+        if self.have_ioboard and not daemon:
+          self.HL.open_ioboard_usb()	# use a USB cable to this IO board if there is one
+        if daemon:
+          self.mirror = self.HL	# the daemon client has the methods of the mirror
+        else:
+          self.mirror = hermeslite.RegisterMirror(self.HL)
+        for item in self.poll_items:
+          item.wake()
       self.comm_time = time.time()
   def KeepAlive(self):
     if time.time() - self.comm_time > 5.0:
       resp = self.HL.response()
       if resp:
-        self.app.temp.set("%.1f" % resp.temperature)
+        self.Show('temp', "%.1f" % resp.temperature)
       else:
+        if isinstance(self.HL, hermeslite.DaemonClient):
+          self.HL.close()
         self.HL = None
         self.have_ioboard = False
-        self.Registers = bytearray(256)
-        self.app.temp.set('')
+        self.mirror = None
+        self.Show('temp', '')
       self.comm_time = time.time()
-  def ReadBoard(self, addr, fullresponse=False):
-    """Read from N2ADR IO board Pico via i2c."""
-    addr = addr & 0xff
-    cmd = bytes([0x07, 0x1d, addr, 0x00])
-    res = self.HL.command(0x3d, cmd, sleep=0, timeout=0.5, attempts=2)
-    if res:
+  def ReadBoard(self, addr, count=4, item=None, force=False):
+    """Read registers from the register mirror. Registers that have not changed are not read again."""
+    read_i2c = self.mirror.read(addr, count, force)
+    if read_i2c:
       self.comm_time = time.time()
-      if fullresponse:
-        return res
-      r = res.response_data
-      return bytes((r & 0xFF, r >> 8 & 0xFF, r >> 16 & 0xFF, r >> 24 & 0xFF))
+      if item:
+        for a in range(addr, addr + count, 16):
+          item.blocks |= 1 << (a >> 4)
+        item.blocks |= 1 << ((addr + count - 1) >> 4)
+    return read_i2c
   def WriteBoard(self, addr, data):
     addr = addr & 0xFF
     data = data & 0xFF
     self.write_queue.put((addr, data))
+    self.queued += 1
+    self.wakeup.set()
+    return self.queued
+  def WriteAll(self):
+    """Write all the values in the write queue. Then read the change counter at once and wake the items."""
+    wrote = False
+    while True:
+      try:
+        addr, data = self.write_queue.get_nowait()
+      except queue.Empty:
+        break
+      if self.mirror.write(addr, data):	# an unchanged value is not written again
+        self.comm_time = time.time()
+      self.written += 1
+      wrote = True
+      if addr >= 170:		# a GPIO pin, so read the pin registers again
+        self.pins_changed = True
+      for item in self.poll_items:
+        if item.blocks & (1 << (addr >> 4)) or (self.pins_changed and item.name == "pins"):
+          item.wake()
+    if wrote:
+      self.change_time = 0
+  def Changes(self):
+    """Return the bitmap of the 16-register blocks that changed."""
+    if isinstance(self.mirror, hermeslite.DaemonClient):
+      return self.mirror.changes()
+    self.mirror.refresh_changes()
+    return self.mirror.changed
   def PollIoBoard(self):
-    if time.time() - self.comm_time > 0.1:
-      app = self.app
-      Reg = self.Registers
-      self.Purge()
-      if not self.write_queue.empty():
-        try:
-          addr, data = self.write_queue.get_nowait()
-        except:
-          traceback.print_exc()
-        else:
-          cmd = bytes([0x06, 0x1d, addr, data])
-          res = self.HL.command(0x3d, cmd, sleep=0, timeout=0.5, attempts=2)
-          if res and res.response_data & 0xFFFFFF == 0x1d << 16 | addr << 8 | data:
-            self.comm_time = time.time()
-          return
-      if self.poll_state == 0:		# Registers 0, 1, 2, 3
-        read_i2c = self.ReadBoard(0, True)
-        if read_i2c:
-          r = read_i2c.response_data
-          r =  bytes((r & 0xFF, r >> 8 & 0xFF, r >> 16 & 0xFF, r >> 24 & 0xFF))
-          Reg[0:4] = r
-          self.app.temp.set("%.1f" % read_i2c.temperature)
-      elif self.poll_state == 1:	# Registers 4, 5, 6, 7
-        read_i2c = self.ReadBoard(4)
-        if read_i2c:
-          Reg[4:4 + 4] = read_i2c
-        tx = Reg[0] << 32 | Reg[1] << 24 | Reg[2] << 16 | Reg[3] << 8 | Reg[4]
-        app.tx_freq.set(FreqFormatter(tx))
-      elif self.poll_state == 2:	# Registers 167, 168, 169, 170
-        read_i2c = self.ReadBoard(167)
-        if read_i2c:	# REG_STATUS, REG_IN_PINS, REG_OUT_PINS, GPIO00_HPF 
-          Reg[167:167 + 4] = read_i2c
-        # Status
-        app.Sw5.set(bool(Reg[167] & 0x01))
-        app.Sw12.set(bool(Reg[167] & 0x02))
-        self.useUartRx = Reg[167] & 0x04
-        # Input pins
-        self.useBandVolts = Reg[168] & 0x80
-        self.useUartTx = Reg[168] & 0x40
-        app.In5.set(bool(Reg[168] & 0x20))
-        app.In4.set(bool(Reg[168] & 0x10))
-        app.In3.set(bool(Reg[168] & 0x08))
-        app.In2.set(bool(Reg[168] & 0x04))
-        if self.useUartRx:
-          app.In1.set(0)
-        else:
-          app.In1.set(bool(Reg[168] & 0x02))
-        app.EXTTR.set(bool(Reg[168] & 0x01))
-        # Output pins
-        if self.useBandVolts and app.ctrlOut8.winfo_ismapped():
-          app.ctrlOut8.grid_remove()
-        if self.useUartTx and app.ctrlOut1.winfo_ismapped():
-          app.ctrlOut1.grid_remove()
-        if self.useUartRx and app.ctrlIn1.winfo_ismapped():
-          app.ctrlIn1.grid_remove()
-        if not self.useBandVolts:
-          app.Out8.set(bool(Reg[169] & 0x80))
-        app.Out7.set(bool(Reg[169] & 0x40))
-        app.Out6.set(bool(Reg[169] & 0x20))
-        app.Out5.set(bool(Reg[169] & 0x10))
-        app.Out4.set(bool(Reg[169] & 0x08))
-        app.Out3.set(bool(Reg[169] & 0x04))
-        app.Out2.set(bool(Reg[169] & 0x02))
-        if not self.useUartTx:
-          app.Out1.set(bool(Reg[169] & 0x01))
-      elif self.poll_state == 3:	# Read register app.reg_index
-        index = app.reg_index.get()	# a string, maybe ""
-        try:
-          index = int(index)
-        except:
-          app.reg_value.set('')
-        else:
-          if 0 <= index <= 252:
-            read_i2c = self.ReadBoard(index)
-            if read_i2c:
-              Reg[index:index + 4] = read_i2c
-              value = Reg[index]
-              app.reg_value.set("%3d, 0x%02X" % (value, value))
-          else:
-            app.reg_value.set('')
-      elif self.poll_state == 4:	# Read GPIO pin app.gpio_index
-        index = app.gpio_index.get()	# a string, maybe ""
-        try:
-          index = int(index)
-        except:
-          app.gpio_value.set('')
-        else:
-          if 0 <= index <= 28:
-            index += 170
-            read_i2c = self.ReadBoard(index)
-            if read_i2c:
-              Reg[index:index + 4] = read_i2c
-              value = Reg[index]
-              app.gpio_value.set("%3d, 0x%02X" % (value, value))
-          else:
-            app.gpio_value.set('')
-      elif self.poll_state == 5:	# named variable
-        name = app.var_name1.get()
-        if name == "Band Volts":
-          read_i2c = self.ReadBoard(178)
-          if read_i2c:
-            Reg[178:178 + 4] = read_i2c
-          if self.useBandVolts:
-            v = Reg[178] / 255.0 * 5.0
-            app.var_value1.set("%.3f volts" % v)
-          else:
-            app.var_value1.set('Not available')
-        elif name == "Fan Volts":
-          read_i2c = self.ReadBoard(12)
-          if read_i2c:
-            Reg[12:12 + 4] = read_i2c
-          v =  3.7 * Reg[12] / 255.0 * 3.3 - 0.7
-          if v < 0:
-            v = 0.0
-          app.var_value1.set("%.1f volts" % v)
-        elif name == "ADC0":
-          read_i2c = self.ReadBoard(25)
-          if read_i2c:
-            Reg[25:25 + 4] = read_i2c
-          v = Reg[25] << 8 | Reg[26]
-          v = v / 4095.0 * 3.0
-          app.var_value1.set("%.3f volts" % v)
-        elif name == "ADC1":
-          read_i2c = self.ReadBoard(27)
-          if read_i2c:
-            Reg[27:27 + 4] = read_i2c
-          v = Reg[27] << 8 | Reg[28]
-          v = v / 4095.0 * 3.0
-          app.var_value1.set("%.3f volts" % v)
-        elif name == "ADC2":
-          read_i2c = self.ReadBoard(29)
-          if read_i2c:
-            Reg[29:29 + 4] = read_i2c
-          v = Reg[29] << 8 | Reg[30]
-          v = v / 4095.0 * 3.0
-          app.var_value1.set("%.3f volts" % v)
-      if self.poll_state >= 5:
-        self.poll_state = 0
+    """Write all waiting values first. Then read the items that are due, highest priority first.
+    Return the time to wait for the next item."""
+    self.Purge()
+    self.WriteAll()
+    if not self.visible.is_set():	# the window is minimized
+      return 0.5
+    if self.remapped.is_set():
+      self.remapped.clear()
+      for item in self.poll_items:
+        item.wake()
+    now = time.time()
+    if now - self.change_time >= CHANGE_PERIOD:
+      self.change_time = now
+      changed = self.Changes()
+      for item in self.poll_items:
+        if item.blocks & changed:
+          item.wake()
+    for item in sorted(self.poll_items, key=lambda x: x.priority):
+      if item.is_due(now):
+        item.run(time.time())
+        self.WriteAll()		# a write waits for at most one item
+    now = time.time()
+    wait = min([item.due for item in self.poll_items] + [self.change_time + CHANGE_PERIOD]) - now
+    return max(0.005, min(wait, 0.1))
+  def PollFrequency(self, item):	# Registers 0 to 7
+    Reg = self.mirror.values
+    data = self.ReadBoard(0, 8, item)
+    if not data:
+      return None
+    if self.mirror.last_response:
+      self.Show('temp', "%.1f" % self.mirror.last_response.temperature)
+    tx = Reg[0] << 32 | Reg[1] << 24 | Reg[2] << 16 | Reg[3] << 8 | Reg[4]
+    self.Show('tx_freq', FreqFormatter(tx))
+    return data
+  def PollPins(self, item):	# Registers 167, 168, 169, 170
+    Reg = self.mirror.values
+    data = self.ReadBoard(167, 4, item, self.pins_changed)	# REG_STATUS, REG_IN_PINS, REG_OUT_PINS, GPIO00_HPF 
+    if not data:
+      return None
+    self.pins_changed = False
+    # Status
+    self.Show('Sw5', bool(Reg[167] & 0x01))
+    self.Show('Sw12', bool(Reg[167] & 0x02))
+    self.useUartRx = Reg[167] & 0x04
+    # Input pins
+    self.useBandVolts = Reg[168] & 0x80
+    self.useUartTx = Reg[168] & 0x40
+    self.Show('In5', bool(Reg[168] & 0x20))
+    self.Show('In4', bool(Reg[168] & 0x10))
+    self.Show('In3', bool(Reg[168] & 0x08))
+    self.Show('In2', bool(Reg[168] & 0x04))
+    if self.useUartRx:
+      self.Show('In1', False)
+    else:
+      self.Show('In1', bool(Reg[168] & 0x02))
+    self.Show('EXTTR', bool(Reg[168] & 0x01))
+    # Output pins
+    self.Show('ctrlOut8', not self.useBandVolts)	# Out8, Out1 and In1 are not shown when used for something else
+    self.Show('ctrlOut1', not self.useUartTx)
+    self.Show('ctrlIn1', not self.useUartRx)
+    if not self.useBandVolts:
+      self.Show('Out8', bool(Reg[169] & 0x80))
+    self.Show('Out7', bool(Reg[169] & 0x40))
+    self.Show('Out6', bool(Reg[169] & 0x20))
+    self.Show('Out5', bool(Reg[169] & 0x10))
+    self.Show('Out4', bool(Reg[169] & 0x08))
+    self.Show('Out3', bool(Reg[169] & 0x04))
+    self.Show('Out2', bool(Reg[169] & 0x02))
+    if not self.useUartTx:
+      self.Show('Out1', bool(Reg[169] & 0x01))
+    return data
+  def PollRegister(self, item):	# Read register app.reg_index
+    index = item.last_key	# a string, maybe ""
+    try:
+      index = int(index)
+    except:
+      self.Show('reg_value', '')
+      return None
+    if 0 <= index <= 252:
+      if self.ReadBoard(index, 1, item):
+        value = self.mirror.values[index]
+        self.Show('reg_value', "%3d, 0x%02X" % (value, value))
+        return (index, value)
+    else:
+      self.Show('reg_value', '')
+    return None
+  def PollGpio(self, item):	# Read GPIO pin app.gpio_index
+    index = item.last_key	# a string, maybe ""
+    try:
+      index = int(index)
+    except:
+      self.Show('gpio_value', '')
+      return None
+    if 0 <= index <= 28:
+      index += 170
+      if self.ReadBoard(index, 1, item):
+        value = self.mirror.values[index]
+        self.Show('gpio_value', "%3d, 0x%02X" % (value, value))
+        return (index, value)
+    else:
+      self.Show('gpio_value', '')
+    return None
+  def PollVariable(self, item):	# named variable
+    Reg = self.mirror.values
+    name = item.last_key
+    if name == "Band Volts":
+      if not self.ReadBoard(178, 1, item):
+        return None
+      if self.useBandVolts:
+        v = Reg[178] / 255.0 * 5.0
+        self.Show('var_value1', "%.3f volts" % v)
       else:
-        self.poll_state += 1
+        self.Show('var_value1', 'Not available')
+      return (name, Reg[178], self.useBandVolts)
+    elif name == "Fan Volts":
+      if not self.ReadBoard(12, 1, item):
+        return None
+      v =  3.7 * Reg[12] / 255.0 * 3.3 - 0.7
+      if v < 0:
+        v = 0.0
+      self.Show('var_value1', "%.1f volts" % v)
+      return (name, Reg[12])
+    elif name in ("ADC0", "ADC1", "ADC2"):
+      index = 25 + int(name[3]) * 2
+      if not self.ReadBoard(index, 2, item):
+        return None
+      v = Reg[index] << 8 | Reg[index + 1]
+      self.Show('var_value1', "%.3f volts" % (v / 4095.0 * 3.0))
+      return (name, v)
+    elif name in ("ADC0 16-bit", "ADC1 16-bit", "ADC2 16-bit"):	# filtered values
+      index = 80 + int(name[3]) * 2
+      if not self.ReadBoard(index, 2, item):
+        return None
+      v = Reg[index] << 8 | Reg[index + 1]
+      self.Show('var_value1', "%.4f volts" % (v / 65535.0 * 3.0))
+      return (name, v)
+    return None
 
 def FreqFormatter(freq):	# Format the string or integer frequency by adding blanks
   freq = int(freq)
@@ -336,9 +449,14 @@ class Application(tk.Tk):
     canvas.create_window(0, topH, anchor=tk.NW, window=self.mainframe)
     canvas.config(scrollregion=(0, 0, width, height), width=width, height=height)
     self.protocol("WM_DELETE_WINDOW", self.OnExit)
+    self.bind('<Map>', self.OnMap)
+    self.bind('<Unmap>', self.OnMap)
+    self.shown = {}		# the values set in the widgets
+    self.pending = {}		# widgets changed by the user, and the number of the write that changes the board
     self.comm_thread = CommThread(self)
     self.comm_thread.daemon = True
     self.comm_thread.start()
+    self.after(REFRESH_MS, self.Refresh)
   def OnExit(self):
     app.comm_thread.stop()
     time.sleep(1.0)
@@ -347,10 +465,52 @@ class Application(tk.Tk):
     #  print (self.comm_thread.is_alive())
     #  time.sleep(0.1)
     self.destroy()
+  def OnMap(self, event):
+    if event.widget is not self:	# the event is for a child widget
+      return
+    thread = self.comm_thread
+    if event.type == tk.EventType.Map:	# the comm thread wakes its own items
+      thread.remapped.set()
+      thread.visible.set()
+      thread.wakeup.set()
+    else:
+      thread.visible.clear()
+  def Refresh(self):
+    """Copy the widget settings to the comm thread, and show the latest state from the comm thread.
+    Only the values that changed are set in the widgets."""
+    thread = self.comm_thread
+    selection = {'reg_index':self.reg_index.get(), 'gpio_index':self.gpio_index.get(), 'var_name1':self.var_name1.get()}
+    if selection != thread.selection:
+      thread.selection = selection
+      thread.wakeup.set()
+    latest = None
+    while True:		# skip to the latest state
+      try:
+        latest = thread.state_queue.get_nowait()
+      except queue.Empty:
+        break
+    if latest:
+      written, state = latest
+      for name, number in list(self.pending.items()):
+        if written >= number:	# the new value was written, so show the value read from the board
+          del self.pending[name]
+          self.shown.pop(name, None)
+      for name, value in state.items():
+        if name in self.pending or (name in self.shown and self.shown[name] == value):
+          continue
+        self.shown[name] = value
+        if name.startswith('ctrl'):	# show or hide the control
+          if value:
+            getattr(self, name).grid()
+          else:
+            getattr(self, name).grid_remove()
+        else:
+          getattr(self, name).set(value)
+    self.after(REFRESH_MS, self.Refresh)
   def ChangeGpio(self, name):
     value = getattr(self, name).get()
     index = self.name2index[name]
-    self.comm_thread.WriteBoard(170 + index, value)
+    self.pending[name] = self.comm_thread.WriteBoard(170 + index, value)
   def ChangeRegister(self, event, title=None, index=None):
     if index is None:
       index = app.reg_index.get()
@@ -461,7 +621,7 @@ class Application(tk.Tk):
     # Combo control
     self.var_name1 = tk.StringVar()
     c = ttk.Combobox(frame, exportselection=0, width=8, state="readonly", style="Readonly.TCombobox", textvariable=self.var_name1,
-        values=("Band Volts", "Fan Volts", "ADC0", "ADC1", "ADC2"))
+        values=("Band Volts", "Fan Volts", "ADC0", "ADC1", "ADC2", "ADC0 16-bit", "ADC1 16-bit", "ADC2 16-bit"))
     c.grid(column=col, row=row, columnspan=2, sticky=(tk.W, tk.E), padx=(10, 5))
     c.current(0)
     self.var_value1 = tk.StringVar()
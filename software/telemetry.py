@@ -0,0 +1,161 @@
+#!/usr/bin/env python
+
+# Decode and record the binary telemetry stream from the IO board USB serial port.
+# See n2adr_lib/telemetry.c for the frame format. Each frame is:
+#   0x7E, type, length, length bytes of payload, CRC MSB, CRC LSB
+# The payload starts with the time in microseconds. Text from printf() on the same port is skipped.
+#
+# To record the stream to a file and print the frames:
+#   python telemetry.py /dev/ttyACM0 record.bin
+# To print the frames in a recording:
+#   python telemetry.py record.bin
+# Recording needs pyserial. Set REG_TELEMETRY on the IO board to select the frames.
+
+import sys, struct, collections
+
+SYNC = 0x7E
+FRAME_REGISTERS = 1
+FRAME_ADC = 2
+FRAME_TRACE = 3
+FRAME_STATS = 4
+
+STATS_NAMES = ('i2c_transactions', 'i2c_written', 'i2c_read', 'i2c_empty', 'unknown_writes', 'band_changes',
+  'exttr_edges', 'uart_rx', 'uart_tx', 'latency_last', 'latency_max')
+
+Frame = collections.namedtuple('Frame', 'type time_us data')
+TraceRecord = collections.namedtuple('TraceRecord', 'time_us event reg value seq')
+
+def crc16_ccitt(data, crc=0xFFFF):
+  """CRC-16/CCITT with polynomial 0x1021, the same as crc16_ccitt() in the firmware."""
+  for byte in data:
+    crc ^= byte << 8
+    for i in range(8):
+      if crc & 0x8000:
+        crc = (crc << 1 ^ 0x1021) & 0xFFFF
+      else:
+        crc = crc << 1 & 0xFFFF
+  return crc
+
+class Decoder:
+  """Feed bytes from the port and get back the frames. Bad frames and other text are skipped."""
+  def __init__(self):
+    self.buffer = bytearray()
+    self.bad_frames = 0
+    self.skipped = 0
+  def feed(self, data):
+    """Add the data and return a list of complete frames."""
+    self.buffer += data
+    frames = []
+    buf = self.buffer
+    while True:
+      start = buf.find(SYNC)
+      if start < 0:
+        self.skipped += len(buf)
+        del buf[:]
+        break
+      if start:
+        self.skipped += start
+        del buf[:start]
+      if len(buf) < 3:
+        break
+      end = 3 + buf[2] + 2
+      if len(buf) < end:
+        break
+      crc = buf[end - 2] << 8 | buf[end - 1]
+      if buf[2] < 4 or crc16_ccitt(buf[1:end - 2]) != crc:	# not a frame, so look for the next sync byte
+        self.bad_frames += 1
+        del buf[:1]
+        continue
+      time_us = struct.unpack('!L', bytes(buf[3:7]))[0]
+      frames.append(Frame(buf[1], time_us, bytes(buf[7:end - 2])))
+      del buf[:end]
+    return frames
+  def flush(self):
+    """Return the frames left in the buffer at the end of the data. A false sync byte may be hiding them."""
+    frames = []
+    while self.buffer:
+      self.skipped += 1
+      del self.buffer[:1]
+      frames += self.feed(b'')
+    return frames
+
+def registers(frame):
+  """Return the first register number and the 16 register values in a FRAME_REGISTERS frame."""
+  return frame.data[0] * 16, frame.data[1:17]
+
+def adc_samples(frame):
+  """Return a list of (channel, sample) in a FRAME_ADC frame."""
+  samples = []
+  for i in range(0, len(frame.data) - 1, 2):
+    s = frame.data[i] << 8 | frame.data[i + 1]
+    samples.append((s >> 12, s & 0x0FFF))
+  return samples
+
+def trace_records(frame):
+  """Return a list of TraceRecord in a FRAME_TRACE frame."""
+  return [TraceRecord(*struct.unpack('!LBBBB', frame.data[i:i + 8])) for i in range(0, len(frame.data) - 7, 8)]
+
+def stats(frame):
+  """Return a dictionary of the counters in a FRAME_STATS frame."""
+  values = struct.unpack('!%dL' % (len(frame.data) // 4), frame.data[0:len(frame.data) // 4 * 4])
+  names = STATS_NAMES + tuple('counter%d' % i for i in range(len(STATS_NAMES), len(values)))
+  return dict(zip(names, values))
+
+def format_frame(frame):
+  """Return a line of text for a frame."""
+  if frame.type == FRAME_REGISTERS:
+    first, values = registers(frame)
+    text = "registers %3d: %s" % (first, ' '.join("%02X" % v for v in values))
+  elif frame.type == FRAME_ADC:
+    text = "adc %s" % ' '.join("%d:%d" % s for s in adc_samples(frame))
+  elif frame.type == FRAME_TRACE:
+    text = "trace %s" % '; '.join("seq %d event %d reg %d value %d at %d" % (r.seq, r.event, r.reg, r.value, r.time_us)
+      for r in trace_records(frame))
+  elif frame.type == FRAME_STATS:
+    text = "stats %s" % ' '.join("%s=%d" % item for item in stats(frame).items())
+  else:
+    text = "type %d length %d" % (frame.type, len(frame.data))
+  return "%10d %s" % (frame.time_us, text)
+
+def record(port, filename=None, verbose=True):
+  """Read the serial port, write the raw bytes to filename, and print the frames. Stop with Control-C."""
+  import serial
+  decoder = Decoder()
+  out = open(filename, 'wb') if filename else None
+  ser = serial.Serial(port, timeout=0.1, exclusive=True)	# hermeslite.py will not use this port
+  try:
+    while True:
+      data = ser.read(4096)
+      if not data:
+        continue
+      if out:
+        out.write(data)
+      for frame in decoder.feed(data):
+        if verbose:
+          print(format_frame(frame))
+  except KeyboardInterrupt:
+    pass
+  finally:
+    ser.close()
+    if out:
+      out.close()
+  print("Bad frames %d, bytes skipped %d" % (decoder.bad_frames, decoder.skipped))
+
+def playback(filename):
+  """Print the frames in a recording."""
+  decoder = Decoder()
+  with open(filename, 'rb') as fp:
+    for frame in decoder.feed(fp.read()) + decoder.flush():
+      print(format_frame(frame))
+  print("Bad frames %d, bytes skipped %d" % (decoder.bad_frames, decoder.skipped))
+
+
+if __name__ == "__main__":
+  if len(sys.argv) == 3:
+    record(sys.argv[1], sys.argv[2])
+  elif len(sys.argv) == 2 and sys.argv[1].endswith('.bin'):
+    playback(sys.argv[1])
+  elif len(sys.argv) == 2:
+    record(sys.argv[1])
+  else:
+    print("Usage: telemetry.py port [record.bin]  or  telemetry.py record.bin")
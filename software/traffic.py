@@ -0,0 +1,346 @@
+#!/usr/bin/env python
+
+# Record IO board register traffic and replay it with the same timing. A capture file has a header, the records,
+# an index and a footer. Each record is a varint of the microseconds since the last record times four plus the
+# kind, and then the register and value for a write or read, or the level for an EXTTR edge. So most records are
+# three or four bytes. The index has an entry for every INDEX_INTERVAL records with the file offset, the record
+# number and the time of the record before it, so a reader can start anywhere. A file that was not closed has no
+# index and is read from the start.
+#
+# A capture is recorded by the host or by the firmware trace:
+#   Set HermesLite.recorder to a CaptureWriter and all IO board reads and writes are recorded, or run
+#   "python hl2_daemon.py --capture file.hl2cap" to record the traffic of all programs that use the daemon.
+#   The firmware trace has the writes and EXTTR edges at the Pico time. Set TRACE_WRITES in REG_TRACE_CONTROL
+#   and record the telemetry trace frames with telemetry.py, then: python traffic.py convert record.bin out.hl2cap
+#   Or read the last records in the trace ring: python traffic.py fetch out.hl2cap [HL2 IP address]
+# To print a capture from a time in seconds:
+#   python traffic.py print file.hl2cap [--start s] [--end s]
+# To replay a capture to the firmware built for the host, or to an HL2 (which may be hl2_emulator.py):
+#   python traffic.py replay file.hl2cap [--ip address] [--fast] [--start s] [--end s]
+# The replay keeps the original timing unless --fast is given. Reads are made and compared with the capture.
+# An HL2 can not make EXTTR edges, so they are only replayed to the host firmware.
+
+import sys, struct, time, bisect, collections, argparse
+import telemetry
+
+CAPTURE_MAGIC = b'HL2C'
+INDEX_MAGIC = b'HL2I'
+CAPTURE_VERSION = 1
+HEADER = struct.Struct('!4sBBxxQ')	# magic, version, source, start time in microseconds since 1970
+INDEX_ENTRY = struct.Struct('!QQL')	# base time, file offset, record number
+FOOTER = struct.Struct('!QL4s')		# index offset, number of entries, magic
+INDEX_INTERVAL = 1024
+
+SOURCE_HOST = 0		# recorded by the host, reads and writes
+SOURCE_FIRMWARE = 1	# from the firmware trace, writes and EXTTR edges
+
+CAPTURE_WRITE = 0	# record kinds
+CAPTURE_READ = 1
+CAPTURE_EXTTR = 2
+
+REG_INPUT_PINS = 6
+REG_TRACE_CONTROL = 104
+REG_TRACE_SEQ_MSB = 105
+REG_TRACE_SIZE = 110
+REG_IN_PINS = 168
+BANK_TRACE = 1
+TRACE_I2C_WRITE = 1
+TRACE_RX_TX = 2
+GPIO13_EXTTR = 13
+REPLAY_GROUP_US = 1000	# replay records within this time of each other together
+
+CaptureRecord = collections.namedtuple('CaptureRecord', 'time_us kind reg value')
+
+def put_varint(out, value):
+  while value >= 0x80:
+    out.append(value & 0x7F | 0x80)
+    value >>= 7
+  out.append(value)
+
+class CaptureWriter:
+  """Write a capture file. Times are microseconds from the start and must not decrease."""
+  def __init__(self, path, source=SOURCE_HOST, start_us=None):
+    self.fp = open(path, 'wb')
+    self.start = time.time()
+    if start_us is None:
+      start_us = int(self.start * 1000000)
+    self.fp.write(HEADER.pack(CAPTURE_MAGIC, CAPTURE_VERSION, source, start_us))
+    self.offset = HEADER.size
+    self.count = 0
+    self.last_us = 0
+    self.index = []
+    self.exttr = None
+  def write(self, time_us, kind, reg=0, value=0):
+    if time_us < self.last_us:
+      time_us = self.last_us
+    if self.count % INDEX_INTERVAL == 0:
+      self.index.append((self.last_us, self.offset, self.count))
+    out = bytearray()
+    put_varint(out, (time_us - self.last_us) << 2 | kind)
+    if kind == CAPTURE_EXTTR:
+      out.append(value & 1)
+    else:
+      out += bytes((reg & 0xFF, value & 0xFF))
+    self.fp.write(out)
+    self.offset += len(out)
+    self.count += 1
+    self.last_us = time_us
+  def now_us(self):
+    return int((time.time() - self.start) * 1000000)
+  def host_write(self, addr, data):
+    """Record a write of data to registers addr, addr + 1, ... made now by the host."""
+    t = self.now_us()
+    for i, value in enumerate(data):
+      self.write(t, CAPTURE_WRITE, addr + i, value)
+  def host_read(self, addr, data):
+    """Record a read of data from registers addr, addr + 1, ... made now by the host. The input pins give EXTTR."""
+    t = self.now_us()
+    for i, value in enumerate(data):
+      reg = (addr + i) & 0xFF
+      self.write(t, CAPTURE_READ, reg, value)
+      if reg in (REG_INPUT_PINS, REG_IN_PINS) and value & 1 != self.exttr:
+        self.exttr = value & 1
+        self.write(t, CAPTURE_EXTTR, 0, self.exttr)
+  def close(self):
+    index_offset = self.offset
+    for entry in self.index:
+      self.fp.write(INDEX_ENTRY.pack(*entry))
+    self.fp.write(FOOTER.pack(index_offset, len(self.index), INDEX_MAGIC))
+    self.fp.close()
+
+class CaptureReader:
+  """Read a capture file."""
+  def __init__(self, path):
+    with open(path, 'rb') as fp:
+      self.data = fp.read()
+    magic, version, self.source, self.start_us = HEADER.unpack_from(self.data, 0)
+    if magic != CAPTURE_MAGIC or version != CAPTURE_VERSION:
+      raise ValueError("%s is not a capture file" % path)
+    self.end = len(self.data)
+    self.index = [(0, HEADER.size, 0)]
+    if len(self.data) >= HEADER.size + FOOTER.size:
+      index_offset, count, magic = FOOTER.unpack_from(self.data, len(self.data) - FOOTER.size)
+      if magic == INDEX_MAGIC:
+        self.end = index_offset
+        self.index = [INDEX_ENTRY.unpack_from(self.data, index_offset + i * INDEX_ENTRY.size) for i in range(count)]
+        if not self.index:
+          self.index = [(0, HEADER.size, 0)]
+  def records(self, start_us=0, end_us=None):
+    """Return a generator of the CaptureRecord from start_us to end_us."""
+    i = max(0, bisect.bisect_left([e[0] for e in self.index], start_us) - 1)	# the record before is earlier
+    time_us, offset, number = self.index[i]
+    data = self.data
+    while offset < self.end:
+      value = shift = 0
+      while True:
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if byte < 0x80:
+          break
+      time_us += value >> 2
+      kind = value & 3
+      if kind == CAPTURE_EXTTR:
+        rec = CaptureRecord(time_us, kind, 0, data[offset])
+        offset += 1
+      else:
+        rec = CaptureRecord(time_us, kind, data[offset], data[offset + 1])
+        offset += 2
+      if end_us is not None and time_us > end_us:
+        break
+      if time_us >= start_us:
+        yield rec
+
+def format_record(rec):
+  if rec.kind == CAPTURE_EXTTR:
+    return "%12.6f EXTTR %s" % (rec.time_us / 1e6, "Rx" if rec.value else "Tx")
+  return "%12.6f %-5s reg %3d value %3d" % (rec.time_us / 1e6, "write" if rec.kind == CAPTURE_WRITE else "read",
+    rec.reg, rec.value)
+
+def convert_trace(records, writer):
+  """Write trace records, a list of telemetry.TraceRecord in order, to a CaptureWriter. The 32-bit
+  firmware time wraps, so it is extended."""
+  base = last = None
+  high = 0
+  for r in records:
+    if last is not None and r.time_us < last:
+      high += 1 << 32
+    last = r.time_us
+    t = high + r.time_us
+    if base is None:
+      base = t
+    if r.event == TRACE_I2C_WRITE:
+      writer.write(t - base, CAPTURE_WRITE, r.reg, r.value)
+    elif r.event == TRACE_RX_TX:
+      writer.write(t - base, CAPTURE_EXTTR, 0, r.value)
+
+def convert_telemetry(filename, out):
+  """Convert the trace frames in a telemetry recording to a capture file."""
+  decoder = telemetry.Decoder()
+  with open(filename, 'rb') as fp:
+    frames = decoder.feed(fp.read()) + decoder.flush()
+  records = []
+  for frame in frames:
+    if frame.type == telemetry.FRAME_TRACE:
+      records += telemetry.trace_records(frame)
+  writer = CaptureWriter(out, SOURCE_FIRMWARE)
+  convert_trace(records, writer)
+  writer.close()
+  return writer.count
+
+def fetch_trace(hl, out):
+  """Read the records in the firmware trace ring with hermeslite and write them to a capture file."""
+  seq = hl.read_ioboard_block(REG_TRACE_SEQ_MSB, 2)
+  bits = hl.read_ioboard_block(REG_TRACE_SIZE, 1)
+  ring = hl.read_ioboard_bank(BANK_TRACE)
+  if not seq or not bits or not ring:
+    return None
+  size = 1 << bits[0]
+  seq = seq[0] << 8 | seq[1]
+  records = []
+  # The register has the low 16 bits of the sequence number, and the ring size divides 65536, so a sequence
+  # number below zero is a record written before the 16 bits wrapped. Slots never written have event zero.
+  for n in range(seq - size, seq):	# the ring records are least significant byte first
+    r = telemetry.TraceRecord(*struct.unpack_from('<LBBBB', ring, (n % size) * 8))
+    if r.seq == n & 0xFF and r.event:
+      records.append(r)
+  writer = CaptureWriter(out, SOURCE_FIRMWARE)
+  convert_trace(records, writer)
+  writer.close()
+  return writer.count
+
+def replay_groups(records, fast):
+  """Return lists of records of the same kind to replay at once."""
+  group = []
+  for rec in records:
+    if group and (rec.kind != group[0].kind or rec.kind == CAPTURE_EXTTR or
+        (not fast and rec.time_us - group[0].time_us > REPLAY_GROUP_US) or len(group) >= 64):
+      yield group
+      group = []
+    group.append(rec)
+  if group:
+    yield group
+
+def runs(group):
+  """Split a group into (first register, records) with consecutive registers."""
+  result = []
+  for rec in group:
+    if result and rec.reg == (result[-1][0] + len(result[-1][1])) & 0xFF:
+      result[-1][1].append(rec)
+    else:
+      result.append((rec.reg, [rec]))
+  return result
+
+class FirmwareTarget:
+  """Replay to the firmware built for the host."""
+  def __init__(self, ioboard):
+    self.ioboard = ioboard
+  def write(self, group):
+    for rec in group:
+      self.ioboard.i2c_write(0x1D, (rec.reg, rec.value))
+  def read(self, group):
+    return [self.ioboard.i2c_read(0x1D, rec.reg, 1)[0] for rec in group]
+  def exttr(self, value):
+    self.ioboard.set_input(GPIO13_EXTTR, value)
+    return True
+
+class HL2Target:
+  """Replay to an HL2 with hermeslite."""
+  def __init__(self, hl):
+    import hermeslite
+    self.hermeslite = hermeslite
+    self.hl = hl
+  def write(self, group):
+    if self.hl.ioboard_usb:
+      for reg, recs in runs(group):
+        self.hl.write_ioboard_block(reg, [r.value for r in recs])
+    else:		# all of the writes in one pipelined engine run
+      self.hl.engine.run([self.hermeslite.ioboard_write_command(r.reg, r.value) for r in group])
+  def read(self, group):
+    values = []
+    for reg, recs in runs(group):
+      data = self.hl.read_ioboard_block(reg, len(recs))
+      values += list(data) if data else [None] * len(recs)
+    return values
+  def exttr(self, value):
+    return False
+
+def replay(reader, target, fast=False, start_us=0, end_us=None, verbose=False):
+  """Replay the records to the target and return a dictionary of results."""
+  result = collections.Counter()
+  late_max = 0
+  t0 = None
+  begin = time.time()
+  for group in replay_groups(reader.records(start_us, end_us), fast):
+    first = group[0]
+    if t0 is None:
+      t0 = time.time() - first.time_us / 1e6
+    if not fast:
+      due = t0 + first.time_us / 1e6
+      wait = due - time.time()
+      if wait > 0:
+        time.sleep(wait)
+      late_max = max(late_max, time.time() - due)
+    if first.kind == CAPTURE_WRITE:
+      target.write(group)
+      result['writes'] += len(group)
+    elif first.kind == CAPTURE_READ:
+      values = target.read(group)
+      result['reads'] += len(group)
+      for rec, value in zip(group, values):
+        if value != rec.value:
+          result['read_differences'] += 1
+          if verbose:
+            print("Read reg %d was %d, now %s" % (rec.reg, rec.value, value))
+    elif target.exttr(first.value):
+      result['exttr'] += 1
+    else:
+      result['exttr_skipped'] += 1
+  result = dict(result)
+  result['seconds'] = time.time() - begin
+  result['late_max_ms'] = late_max * 1000
+  return result
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description="Record and replay IO board register traffic")
+  parser.add_argument('command', choices=('print', 'convert', 'fetch', 'replay'))
+  parser.add_argument('files', nargs='+')
+  parser.add_argument('--ip', help="HL2 IP address for fetch and replay")
+  parser.add_argument('--lib', help="firmware library for replay, see hl2_emulator.py")
+  parser.add_argument('--fast', action='store_true', help="replay as fast as possible")
+  parser.add_argument('--start', type=float, default=0.0, help="start time in seconds")
+  parser.add_argument('--end', type=float, help="end time in seconds")
+  parser.add_argument('--verbose', action='store_true')
+  args = parser.parse_args()
+  start_us = int(args.start * 1000000)
+  end_us = None if args.end is None else int(args.end * 1000000)
+  if args.command == 'print':
+    for rec in CaptureReader(args.files[0]).records(start_us, end_us):
+      print(format_record(rec))
+  elif args.command == 'convert':
+    print("Wrote %d records" % convert_telemetry(args.files[0], args.files[1]))
+  elif args.command == 'fetch':
+    import hermeslite
+    hl = hermeslite.discover_first(1, ip=args.ip)
+    count = fetch_trace(hl, args.files[0]) if hl else None
+    print("No HL2 or no trace" if count is None else "Wrote %d records" % count)
+  else:
+    reader = CaptureReader(args.files[0])
+    if args.ip:
+      import hermeslite
+      hl = hermeslite.discover_first(1, ip=args.ip)
+      if not hl:
+        sys.exit("No HL2 at %s" % args.ip)
+      target = HL2Target(hl)
+    else:
+      import hl2_emulator
+      ioboard = hl2_emulator.FirmwareIoBoard(args.lib or hl2_emulator.default_library())
+      ioboard.start()
+      target = FirmwareTarget(ioboard)
+    result = replay(reader, target, args.fast, start_us, end_us, args.verbose)
+    count = result.get('writes', 0) + result.get('reads', 0) + result.get('exttr', 0)
+    print(' '.join("%s=%s" % (k, round(v, 3) if isinstance(v, float) else v) for k, v in sorted(result.items())))
+    if result['seconds'] > 0:
+      print("%.0f records per second" % (count / result['seconds']))